@@ -0,0 +1,384 @@
+#include "corpus.h"
+
+#include "blackdetectthread.h"
+#include "frameextractionthread.h"
+#include "project.h"
+#include "scdetthread.h"
+#include "silencedetectthread.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::pair<int, int> synthetic_frame_rate_a{25, 1};
+constexpr std::pair<int, int> synthetic_frame_rate_b{24, 1};
+// hash of a black frame, and number of frames of a fade to black
+constexpr quint64 black_hash = 0;
+constexpr int fade_frames = 4;
+
+quint64 flip_bits(std::mt19937_64& rng, quint64 hash, int n)
+{
+  for (int i(0); i < n; ++i)
+  {
+    hash ^= quint64(1) << (rng() % 64);
+  }
+  return hash;
+}
+
+// Returns the hashes of a scene, which change slowly from one frame to the next.
+std::vector<quint64> generate_scene(std::mt19937_64& rng)
+{
+  const int length = 15 + int(rng() % 140);
+  std::vector<quint64> hashes;
+  hashes.reserve(length);
+
+  quint64 base = rng();
+  for (int i(0); i < length; ++i)
+  {
+    if (rng() % 4 == 0)
+    {
+      base = flip_bits(rng, base, 1);
+    }
+    hashes.push_back(flip_bits(rng, base, int(rng() % 3)));
+  }
+
+  return hashes;
+}
+
+std::runtime_error load_error(const QString& filePath, const QString& message)
+{
+  return std::runtime_error((filePath + ": " + message).toStdString());
+}
+
+std::unique_ptr<MediaObject> load_media(const QJsonObject& obj, const QDir& dir, const QString& manifestPath)
+{
+  const QJsonArray rate = obj["frameRate"].toArray();
+  if (rate.size() != 2 || rate.at(0).toInt() <= 0 || rate.at(1).toInt() <= 0)
+  {
+    throw load_error(manifestPath, "bad frame rate");
+  }
+
+  auto media = std::make_unique<MediaObject>(obj["name"].toString(),
+                                             obj["duration"].toDouble(),
+                                             std::make_pair(rate.at(0).toInt(), rate.at(1).toInt()));
+
+  // the frames file was written for the recorded media, whose fingerprint is not known here
+  std::unique_ptr<FramesInfo> frames = FramesInfo::load(dir.filePath(obj["frames"].toString()));
+  if (!frames || frames->empty())
+  {
+    throw load_error(manifestPath, "no frames in " + obj["frames"].toString());
+  }
+  media->setFramesInfo(std::move(frames));
+
+  if (obj.contains("silences"))
+  {
+    auto info = std::make_unique<SilenceInfo>();
+    info->minimumDuration = SilencedetectThread::duration();
+    const QString path = dir.filePath(obj["silences"].toString());
+    if (!read_silencedetect_from_disk(info->silences, info->minimumDuration, path))
+    {
+      throw load_error(manifestPath, "could not read " + path);
+    }
+    media->setSilenceInfo(std::move(info));
+  }
+
+  if (obj.contains("blackframes"))
+  {
+    auto info = std::make_unique<BlackFramesInfo>();
+    info->minimumDuration = BlackdetectThread::duration();
+    const QString path = dir.filePath(obj["blackframes"].toString());
+    if (!read_blackdetect_from_disk(info->blackframes, info->minimumDuration, path))
+    {
+      throw load_error(manifestPath, "could not read " + path);
+    }
+    media->setBlackFramesInfo(std::move(info));
+  }
+
+  if (obj.contains("scenechanges"))
+  {
+    auto info = std::make_unique<ScenesInfo>();
+    const QString path = dir.filePath(obj["scenechanges"].toString());
+    if (!read_scdet_results_from_disk(info->scenechanges, path))
+    {
+      throw load_error(manifestPath, "could not read " + path);
+    }
+    media->setScenesInfo(std::move(info));
+  }
+
+  return media;
+}
+
+// Copies a cache file of the media to `dir`, under the name `name`.
+void copy_cache_file(const QString& cacheFilePath, const QDir& dir, const QString& name)
+{
+  const QString dest = dir.filePath(name);
+  QFile::remove(dest);
+  if (!QFile::copy(cacheFilePath, dest))
+  {
+    throw std::runtime_error(("could not copy " + cacheFilePath + ", was the match detection run?").toStdString());
+  }
+}
+
+// Copies the caches of a media, named as by the detection threads, and returns its manifest entry.
+QJsonObject record_media(const QString& filePath, const QDir& dir, const QString& prefix, bool primary)
+{
+  const MediaObject media{filePath};
+
+  QJsonObject obj;
+  obj["name"] = media.fileName();
+  obj["duration"] = media.duration();
+  obj["frameRate"] = QJsonArray{media.frameRateAsRational().first, media.frameRateAsRational().second};
+
+  // the cache keeps the frames raw to map them, the episode is an archive and packs them
+  const QString frames_path = FrameExtractionThread::cacheFilePath(media.cacheKey());
+  const std::unique_ptr<FramesInfo> frames = FramesInfo::load(frames_path, media.cacheKey());
+  if (!frames
+      || !frames->save(dir.filePath(prefix + ".frames"), frames->frameRate(), media.cacheKey(), FramesInfo::Packed))
+  {
+    throw std::runtime_error(("could not pack " + frames_path + ", was the match detection run?").toStdString());
+  }
+  obj["frames"] = prefix + ".frames";
+
+  // the detections are only used on the first video
+  if (primary)
+  {
+    copy_cache_file(SilencedetectThread::cacheFilePath(media.cacheKey()), dir, prefix + ".silencedetect");
+    obj["silences"] = prefix + ".silencedetect";
+    copy_cache_file(BlackdetectThread::cacheFilePath(media.cacheKey()), dir, prefix + ".blackdetect");
+    obj["blackframes"] = prefix + ".blackdetect";
+    copy_cache_file(ScdetThread::cacheFilePath(media.cacheKey()), dir, prefix + ".scdet");
+    obj["scenechanges"] = prefix + ".scdet";
+  }
+
+  return obj;
+}
+
+// Returns the position in the second video of the frame at `time` in the first one,
+// or -1 if the frame is not in any of the matches, which must be sorted.
+double map_time(const std::vector<VideoMatch>& matches, int64_t time)
+{
+  auto it = std::upper_bound(matches.begin(), matches.end(), time, [](int64_t t, const VideoMatch& m) {
+    return t < m.a.start();
+  });
+
+  if (it == matches.begin() || !std::prev(it)->a.contains(time))
+  {
+    return -1;
+  }
+
+  const VideoMatch& m = *std::prev(it);
+  const double speed = m.b.duration() / double(m.a.duration());
+  return m.b.start() + (time - m.a.start()) * speed;
+}
+
+} // namespace
+
+BenchEpisode generateEpisode(const SyntheticEpisodeOptions& options, quint64 seed)
+{
+  std::mt19937_64 rng{seed};
+  std::uniform_real_distribution<double> chance{0, 1};
+
+  const double delta_a = 1000.0 * synthetic_frame_rate_a.second / synthetic_frame_rate_a.first;
+  const double delta_b = 1000.0 * synthetic_frame_rate_b.second / synthetic_frame_rate_b.first;
+  // frames of the first video elapsed between two frames of the second one
+  const double step = delta_b / delta_a / options.speed;
+
+  std::vector<VideoFrameInfo> frames_a;
+  std::vector<VideoFrameInfo> frames_b;
+  auto silences = std::make_unique<SilenceInfo>();
+  silences->minimumDuration = SilencedetectThread::duration();
+  auto blackframes = std::make_unique<BlackFramesInfo>();
+  blackframes->minimumDuration = BlackdetectThread::duration();
+  auto scenes = std::make_unique<ScenesInfo>();
+
+  BenchEpisode episode;
+  episode.name = "synthetic-" + QString::number(seed);
+
+  int pts_a = 0;
+  int pts_b = 0;
+
+  for (int s(0); s < options.scenes; ++s)
+  {
+    std::vector<quint64> hashes = generate_scene(rng);
+    const int first_a = pts_a;
+    const int length = int(hashes.size());
+
+    if (chance(rng) < options.fades)
+    {
+      for (int i = length - fade_frames; i < length; ++i)
+      {
+        hashes[i] = flip_bits(rng, black_hash, 1);
+      }
+      blackframes->blackframes.push_back(
+          TimeSegment::between((first_a + length - fade_frames) * delta_a, (first_a + length) * delta_a));
+    }
+
+    for (quint64 h : hashes)
+    {
+      frames_a.push_back(VideoFrameInfo{.pts = pts_a++, .phash = h});
+    }
+
+    scenes->scenechanges.push_back(SceneChange{.score = 0.5 + (rng() % 50) / 100.0, .time = first_a * delta_a / 1000});
+
+    // dialogues tend to stop at the end of a scene
+    if (rng() % 3 == 0)
+    {
+      silences->silences.push_back(TimeSegment::between((pts_a - 6) * delta_a, (pts_a + 2) * delta_a));
+    }
+
+    if (chance(rng) < options.deletions)
+    {
+      continue;
+    }
+
+    if (chance(rng) < options.insertions)
+    {
+      for (quint64 h : generate_scene(rng))
+      {
+        frames_b.push_back(VideoFrameInfo{.pts = pts_b++, .phash = h});
+      }
+    }
+
+    const int first_b = pts_b;
+    for (double pos = 0; pos < length; pos += step)
+    {
+      const quint64 h = flip_bits(rng, hashes[size_t(pos)], int(rng() % (options.noise + 1)));
+      frames_b.push_back(VideoFrameInfo{.pts = pts_b++, .phash = h});
+    }
+
+    const int64_t start_b = first_b * delta_b;
+    episode.truth.push_back(VideoMatch{TimeSegment::between(first_a * delta_a, pts_a * delta_a),
+                                       TimeSegment::between(start_b, start_b + length * delta_a * options.speed)});
+  }
+
+  episode.a = std::make_unique<MediaObject>(episode.name + "-a.mkv", pts_a * delta_a / 1000, synthetic_frame_rate_a);
+  episode.a->setFramesInfo(std::make_unique<FramesInfo>(frames_a));
+  episode.a->setSilenceInfo(std::move(silences));
+  episode.a->setBlackFramesInfo(std::move(blackframes));
+  episode.a->setScenesInfo(std::move(scenes));
+
+  episode.b = std::make_unique<MediaObject>(episode.name + "-b.mkv", pts_b * delta_b / 1000, synthetic_frame_rate_b);
+  episode.b->setFramesInfo(std::make_unique<FramesInfo>(frames_b));
+
+  return episode;
+}
+
+BenchEpisode loadEpisode(const QString& manifestPath)
+{
+  QFile file{manifestPath};
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    throw load_error(manifestPath, "could not open file");
+  }
+
+  const QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+  if (!manifest.contains("a") || !manifest.contains("b"))
+  {
+    throw load_error(manifestPath, "not an episode manifest");
+  }
+
+  const QDir dir = QFileInfo(manifestPath).dir();
+
+  BenchEpisode episode;
+  episode.name = manifest["name"].toString();
+  episode.a = load_media(manifest["a"].toObject(), dir, manifestPath);
+  episode.b = load_media(manifest["b"].toObject(), dir, manifestPath);
+
+  if (!episode.a->silenceInfo() || !episode.a->blackFramesInfo() || !episode.a->scenesInfo())
+  {
+    throw load_error(manifestPath, "the detections of the first video are missing");
+  }
+
+  for (const QJsonValue& m : manifest["matches"].toArray())
+  {
+    episode.truth.push_back(MatchObject(m.toString()).value());
+  }
+
+  std::sort(episode.truth.begin(), episode.truth.end(), [](const VideoMatch& lhs, const VideoMatch& rhs) {
+    return lhs.a.start() < rhs.a.start();
+  });
+
+  return episode;
+}
+
+QString recordEpisode(const DubbingProject& project, const QString& dirPath)
+{
+  if (project.matches().empty())
+  {
+    throw std::runtime_error("the project has no matches");
+  }
+
+  if (!QDir().mkpath(dirPath))
+  {
+    throw std::runtime_error(("could not create " + dirPath).toStdString());
+  }
+
+  const QDir dir{dirPath};
+
+  QJsonObject manifest;
+  manifest["name"] = project.projectTitle().isEmpty() ? QFileInfo(project.projectFilePath()).completeBaseName()
+                                                      : project.projectTitle();
+  manifest["a"] = record_media(project.resolvePath(project.videoFilePath()), dir, "a", true);
+  manifest["b"] = record_media(project.resolvePath(project.audioSourceFilePath()), dir, "b", false);
+
+  QJsonArray matches;
+  for (const MatchObject* m : project.matches())
+  {
+    matches.append(m->toString());
+  }
+  manifest["matches"] = matches;
+
+  const QString manifest_path = dir.filePath("episode.json");
+  QFile file{manifest_path};
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    throw std::runtime_error(("could not write " + manifest_path).toStdString());
+  }
+
+  file.write(QJsonDocument(manifest).toJson());
+  return manifest_path;
+}
+
+MatchAccuracy scoreMatches(const BenchEpisode& episode, const std::vector<VideoMatch>& matches, int64_t tolerance)
+{
+  MatchAccuracy result;
+
+  std::vector<VideoMatch> sorted_matches = matches;
+  std::sort(sorted_matches.begin(), sorted_matches.end(), [](const VideoMatch& lhs, const VideoMatch& rhs) {
+    return lhs.a.start() < rhs.a.start();
+  });
+
+  for (int pts : episode.a->framesInfo()->pts())
+  {
+    const int64_t time = episode.a->convertPtsToPosition(pts);
+    const double expected = map_time(episode.truth, time);
+    const double found = map_time(sorted_matches, time);
+
+    if (expected >= 0)
+    {
+      ++result.expected;
+    }
+
+    if (found >= 0)
+    {
+      ++result.found;
+
+      if (expected >= 0 && std::abs(found - expected) <= tolerance)
+      {
+        ++result.correct;
+      }
+    }
+  }
+
+  return result;
+}
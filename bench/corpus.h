@@ -0,0 +1,71 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef DIGIDUB_BENCH_CORPUS_H
+#define DIGIDUB_BENCH_CORPUS_H
+
+#include "match.h"
+#include "mediaobject.h"
+
+#include <memory>
+#include <vector>
+
+class DubbingProject;
+
+// A pair of videos whose matches are known.
+struct BenchEpisode
+{
+  QString name;
+  std::unique_ptr<MediaObject> a;
+  std::unique_ptr<MediaObject> b;
+  std::vector<VideoMatch> truth;
+};
+
+// How the second video of a synthetic episode differs from the first one.
+struct SyntheticEpisodeOptions
+{
+  int scenes = 300;
+  // probability that a scene of the first video is missing from the second one
+  double deletions = 0.05;
+  // probability that a scene of the second video is missing from the first one
+  double insertions = 0.05;
+  // duration of a scene in the second video divided by its duration in the first one
+  double speed = 1;
+  // probability that a scene ends with a fade to black
+  double fades = 0.1;
+  // maximum number of bits flipped in each hash of the second video
+  int noise = 6;
+};
+
+// Generates an episode from random hash sequences; the first video is at 25 fps,
+// the second one at 24 fps.
+BenchEpisode generateEpisode(const SyntheticEpisodeOptions& options, quint64 seed);
+
+// Loads an episode written by recordEpisode(); throws std::runtime_error on failure.
+BenchEpisode loadEpisode(const QString& manifestPath);
+
+// Copies the cached frame hashes and detection results of the videos of a
+// reviewed project to `dirPath`, along with a manifest holding the matches of
+// the project as ground truth; returns the path of the manifest.
+// The project must have been created with match detection, so that the caches exist.
+// Throws std::runtime_error on failure.
+QString recordEpisode(const DubbingProject& project, const QString& dirPath);
+
+// Accuracy of the matches found for an episode, measured on each frame of the first video.
+struct MatchAccuracy
+{
+  // frames that have a match in the ground truth
+  int expected = 0;
+  // frames that have a match in the result
+  int found = 0;
+  // frames matched within the tolerance of their match in the ground truth
+  int correct = 0;
+
+  double recall() const { return expected ? correct / double(expected) : 1; }
+  double precision() const { return found ? correct / double(found) : 1; }
+};
+
+MatchAccuracy scoreMatches(const BenchEpisode& episode, const std::vector<VideoMatch>& matches, int64_t tolerance);
+
+#endif // DIGIDUB_BENCH_CORPUS_H
@@ -0,0 +1,757 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "corpus.h"
+
+#include "hamming.h"
+#include "hashindex.h"
+#include "matchalgo.h"
+#include "phash.h"
+#include "project.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVersionNumber>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+static bool helpRequested(const QStringList& args)
+{
+  return args.contains("-h") || args.contains("--help") || args.contains("-?");
+}
+
+namespace HammingBenchmark {
+
+// Returns the best of a few runs, in msecs.
+template<typename F>
+double measure(F&& f)
+{
+  double best = std::numeric_limits<double>::max();
+  for (int i(0); i < 3; ++i)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    f();
+    best = std::min(best, timer.nsecsElapsed() / 1e6);
+  }
+  return best;
+}
+
+} // namespace HammingBenchmark
+
+constexpr const char* CMD_HAMMING_DESCRIPTION =
+    R"(Compares the time taken by slidingHammingDistances() with each
+of the kernels supported by the cpu and by hammingDistanceProfile()
+(FFT), for a range of pattern sizes and numbers of offsets.
+For each number of offsets, the smallest pattern size for which the
+FFT is faster than each kernel is reported.
+)";
+
+int bench_hamming(const QStringList& args)
+{
+  QTextStream cout{stdout};
+
+  if (helpRequested(args))
+  {
+    cout << "BENCHMARK hamming" << Qt::endl;
+    cout << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_HAMMING_DESCRIPTION << Qt::endl;
+    return 0;
+  }
+
+  std::vector<HammingKernel> kernels;
+  for (HammingKernel k : {HammingKernel::Scalar, HammingKernel::AVX2, HammingKernel::AVX512})
+  {
+    if (isHammingKernelSupported(k))
+    {
+      kernels.push_back(k);
+    }
+  }
+
+  const HammingKernel default_kernel = hammingKernel();
+  std::mt19937_64 rng{42};
+
+  cout << QString("offsets").rightJustified(8) << QString("n").rightJustified(8);
+  for (HammingKernel k : kernels)
+  {
+    cout << QString(hammingKernelName(k)).rightJustified(12);
+  }
+  cout << QString("fft").rightJustified(12) << "  (msecs, * = method chosen by default)" << Qt::endl;
+
+  for (size_t count : {1000, 4000, 16000, 64000})
+  {
+    std::vector<size_t> crossovers(kernels.size(), 0);
+
+    for (size_t n : {64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384})
+    {
+      std::vector<quint64> pattern(n);
+      std::vector<quint64> search(count + n - 1);
+      std::generate(pattern.begin(), pattern.end(), std::ref(rng));
+      std::generate(search.begin(), search.end(), std::ref(rng));
+      std::vector<int> distances(count);
+
+      cout << QString::number(count).rightJustified(8) << QString::number(n).rightJustified(8);
+
+      const bool fft_chosen = isHammingDistanceProfileFaster(n, count);
+
+      const double fft_time = HammingBenchmark::measure([&]() {
+        hammingDistanceProfile(pattern.data(), n, search.data(), count, distances.data());
+      });
+
+      for (size_t i(0); i < kernels.size(); ++i)
+      {
+        setHammingKernel(kernels[i]);
+        const double time = HammingBenchmark::measure([&]() {
+          slidingHammingDistances(pattern.data(), n, search.data(), count, distances.data());
+        });
+
+        if (crossovers[i] == 0 && fft_time < time)
+        {
+          crossovers[i] = n;
+        }
+
+        const bool chosen = !fft_chosen && kernels[i] == default_kernel;
+        cout << (QString::number(time, 'f', 2) + (chosen ? "*" : " ")).rightJustified(12);
+      }
+
+      cout << (QString::number(fft_time, 'f', 2) + (fft_chosen ? "*" : " ")).rightJustified(12)
+           << Qt::endl;
+    }
+
+    for (size_t i(0); i < kernels.size(); ++i)
+    {
+      cout << "  crossover with " << hammingKernelName(kernels[i]) << ": ";
+      if (crossovers[i])
+      {
+        cout << "n >= " << crossovers[i] << Qt::endl;
+      }
+      else
+      {
+        cout << "none" << Qt::endl;
+      }
+    }
+  }
+
+  setHammingKernel(default_kernel);
+
+  return 0;
+}
+
+constexpr const char* CMD_HASHINDEX_DESCRIPTION =
+    R"(Compares the time taken to find the frames within a given hamming
+radius of a hash with MatchAlgo::HashIndex and with a linear scan,
+on a synthetic video made of scenes of slowly changing hashes.
+The results of both methods are checked to be the same.
+)";
+
+int bench_hashindex(const QStringList& args)
+{
+  QTextStream cout{stdout};
+
+  if (helpRequested(args))
+  {
+    cout << "BENCHMARK hashindex" << Qt::endl;
+    cout << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_HASHINDEX_DESCRIPTION << Qt::endl;
+    return 0;
+  }
+
+  std::mt19937_64 rng{42};
+
+  auto flip_bits = [&rng](quint64 hash, int n) {
+    for (int i(0); i < n; ++i)
+    {
+      hash ^= quint64(1) << (rng() % 64);
+    }
+    return hash;
+  };
+
+  // about 30 minutes at 24 fps, with a scene change every 4 seconds or so
+  std::vector<quint64> hashes(40000);
+  for (size_t i(0); i < hashes.size(); ++i)
+  {
+    hashes[i] = (i % 100 == 0) ? rng() : flip_bits(hashes[i - 1], 1);
+  }
+
+  std::vector<quint64> queries(1000);
+  for (quint64& q : queries)
+  {
+    q = flip_bits(hashes[rng() % hashes.size()], 3);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  MatchAlgo::HashIndex index{hashes.data(), hashes.size()};
+  cout << "index of " << hashes.size() << " hashes built in "
+       << QString::number(timer.nsecsElapsed() / 1e6, 'f', 2) << " msecs" << Qt::endl;
+
+  cout << QString("radius").rightJustified(8) << QString("found").rightJustified(10)
+       << QString("scan").rightJustified(12) << QString("index").rightJustified(12)
+       << "  (average per query, msecs)" << Qt::endl;
+
+  for (int radius : {0, 4, 8, 12, 16, 20})
+  {
+    std::vector<std::vector<size_t>> expected(queries.size());
+    std::vector<std::vector<size_t>> found(queries.size());
+
+    const double scan_time = HammingBenchmark::measure([&]() {
+      for (size_t i(0); i < queries.size(); ++i)
+      {
+        expected[i].clear();
+        for (size_t j(0); j < hashes.size(); ++j)
+        {
+          if (phashDist(queries[i], hashes[j]) <= radius)
+          {
+            expected[i].push_back(j);
+          }
+        }
+      }
+    });
+
+    const double index_time = HammingBenchmark::measure([&]() {
+      for (size_t i(0); i < queries.size(); ++i)
+      {
+        found[i] = index.find(queries[i], radius);
+      }
+    });
+
+    if (found != expected)
+    {
+      QTextStream(stderr) << "HashIndex::find() returned wrong results for radius " << radius
+                          << Qt::endl;
+      return 1;
+    }
+
+    size_t nb_found = 0;
+    for (const std::vector<size_t>& f : found)
+    {
+      nb_found += f.size();
+    }
+
+    cout << QString::number(radius).rightJustified(8)
+         << QString::number(double(nb_found) / queries.size(), 'f', 1).rightJustified(10)
+         << QString::number(scan_time / queries.size(), 'f', 4).rightJustified(12)
+         << QString::number(index_time / queries.size(), 'f', 4).rightJustified(12) << Qt::endl;
+  }
+
+  return 0;
+}
+
+namespace MatchingBenchmark {
+
+struct Engine
+{
+  const char* name;
+  MatchAlgo::MatchEngine engine;
+  bool pyramidSearch = false;
+};
+
+// the pyramid variants compare the accuracy of Parameters::pyramidSearch
+// with the exact search
+constexpr Engine engines[] = {
+    {"exhaustive", MatchAlgo::MatchEngine::Exhaustive},
+    {"pyramid", MatchAlgo::MatchEngine::Exhaustive, true},
+    {"seed", MatchAlgo::MatchEngine::SeedAndExtend},
+    {"seed+pyr", MatchAlgo::MatchEngine::SeedAndExtend, true},
+    {"align", MatchAlgo::MatchEngine::GlobalAlignment},
+    {"warp", MatchAlgo::MatchEngine::TimeWarp},
+};
+
+QJsonObject to_json(const MatchAlgo::SearchStats& stats)
+{
+  QJsonObject result;
+  result["offsets"] = qint64(stats.offsets);
+  result["offsets_skipped"] = qint64(stats.offsetsSkipped);
+  result["offsets_abandoned"] = qint64(stats.offsetsAbandoned);
+  result["distances"] = qint64(stats.distances);
+  result["distances_pruned"] = qint64(stats.distancesPruned);
+  result["fft_searches"] = qint64(stats.fftSearches);
+  result["pyramid_searches"] = qint64(stats.pyramidSearches);
+  return result;
+}
+
+// Runs the match detector on an episode with each engine, and prints a line for each of them.
+QJsonObject run_episode(QTextStream& cout,
+                        const BenchEpisode& episode,
+                        const std::vector<Engine>& selectedEngines,
+                        int64_t tolerance)
+{
+  QJsonObject result;
+  result["name"] = episode.name;
+  result["frames_a"] = qint64(episode.a->framesInfo()->size());
+  result["frames_b"] = qint64(episode.b->framesInfo()->size());
+  result["expected_matches"] = qint64(episode.truth.size());
+
+  // the kernels that MatchDetector::run() starts with
+  QJsonObject kernels;
+  kernels["video"] = HammingBenchmark::measure([&]() {
+    MatchAlgo::Video a{*episode.a};
+    MatchAlgo::Video b{*episode.b};
+  });
+  const MatchAlgo::Video video_b{*episode.b};
+  kernels["hash_index"] = HammingBenchmark::measure([&]() { MatchAlgo::HashIndex index{video_b}; });
+  result["kernels"] = kernels;
+
+  QJsonArray jengines;
+  for (const Engine& e : selectedEngines)
+  {
+    MatchDetector detector{*episode.a, *episode.b};
+    detector.parameters.engine = e.engine;
+    detector.parameters.pyramidSearch = e.pyramidSearch;
+
+    std::vector<VideoMatch> matches;
+    MatchAlgo::SearchStats stats;
+    const double time = HammingBenchmark::measure([&]() {
+      const MatchAlgo::SearchStats stats_before = MatchAlgo::searchStats();
+      matches = detector.run();
+      stats = MatchAlgo::searchStats() - stats_before;
+    });
+
+    const MatchAccuracy accuracy = scoreMatches(episode, matches, tolerance);
+
+    QJsonObject obj;
+    obj["engine"] = e.name;
+    obj["time"] = time;
+    obj["matches"] = qint64(matches.size());
+    obj["expected_frames"] = accuracy.expected;
+    obj["found_frames"] = accuracy.found;
+    obj["correct_frames"] = accuracy.correct;
+    obj["recall"] = accuracy.recall();
+    obj["precision"] = accuracy.precision();
+    obj["stats"] = to_json(stats);
+    jengines.append(obj);
+
+    cout << episode.name.leftJustified(24) << QString(e.name).leftJustified(12)
+         << QString::number(time, 'f', 1).rightJustified(10)
+         << QString::number(matches.size()).rightJustified(9)
+         << QString::number(accuracy.recall(), 'f', 4).rightJustified(9)
+         << QString::number(accuracy.precision(), 'f', 4).rightJustified(10) << Qt::endl;
+  }
+  result["engines"] = jengines;
+
+  return result;
+}
+
+} // namespace MatchingBenchmark
+
+constexpr const char* CMD_MATCHING_DESCRIPTION =
+    R"(Runs MatchDetector::run() with each engine on a corpus of episodes
+whose matches are known, and reports the time taken (best of 3 runs),
+the time taken by the kernels it starts with, and the accuracy of the
+matches: the fraction of the frames of the first video that are matched
+within the tolerance of the ground truth (recall), and the fraction of
+the matched frames that are (precision).
+The corpus is made of synthetic episodes generated from random hash
+sequences, with one seed per episode, and of the recorded episodes
+passed with `--episode` (see the record benchmark).
+OPTIONS:
+  --seeds N         number of synthetic episodes (default: 3)
+  --scenes N        number of scenes of each synthetic episode (default: 300)
+  --deletions P     probability that a scene is missing from the second video
+  --insertions P    probability that a scene is added to the second video
+  --speed X         duration of the scenes in the second video divided by
+                    their duration in the first one (default: 1)
+  --fades P         probability that a scene ends with a fade to black
+  --noise N         maximum number of bits flipped in each hash of the second video
+  --episode FILE    adds a recorded episode (episode.json)
+  --engine NAME     exhaustive, pyramid, seed, seed+pyr, align or warp
+                    (default: all of them); pyramid and seed+pyr are the
+                    exhaustive and seed engines with the pyramid search
+  --tolerance MS    tolerance of the accuracy, in msecs (default: 200)
+  --json FILE       writes the results to a JSON file, for regression tracking
+)";
+
+int bench_matching(const QStringList& args)
+{
+  QTextStream cout{stdout};
+  QTextStream cerr{stderr};
+
+  if (helpRequested(args))
+  {
+    cout << "BENCHMARK matching" << Qt::endl;
+    cout << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_MATCHING_DESCRIPTION << Qt::endl;
+    return 0;
+  }
+
+  SyntheticEpisodeOptions options;
+  int nb_seeds = 3;
+  QStringList episode_paths;
+  std::vector<MatchingBenchmark::Engine> engines;
+  int64_t tolerance = 200;
+  QString json_path;
+
+  for (int i(0); i < args.size();)
+  {
+    const QString& a = args.at(i++);
+    if (i == args.size())
+    {
+      cerr << "Missing value after " << a << "." << Qt::endl;
+      return 1;
+    }
+
+    const QString& value = args.at(i++);
+
+    if (a == "--seeds")
+    {
+      nb_seeds = value.toInt();
+    }
+    else if (a == "--scenes")
+    {
+      options.scenes = value.toInt();
+    }
+    else if (a == "--deletions")
+    {
+      options.deletions = value.toDouble();
+    }
+    else if (a == "--insertions")
+    {
+      options.insertions = value.toDouble();
+    }
+    else if (a == "--speed")
+    {
+      options.speed = value.toDouble();
+    }
+    else if (a == "--fades")
+    {
+      options.fades = value.toDouble();
+    }
+    else if (a == "--noise")
+    {
+      options.noise = value.toInt();
+    }
+    else if (a == "--episode")
+    {
+      episode_paths.push_back(value);
+    }
+    else if (a == "--engine")
+    {
+      auto it = std::find_if(std::begin(MatchingBenchmark::engines),
+                             std::end(MatchingBenchmark::engines),
+                             [&value](const MatchingBenchmark::Engine& e) { return value == e.name; });
+      if (it == std::end(MatchingBenchmark::engines))
+      {
+        cerr << "Unknown engine: " << value << "." << Qt::endl;
+        return 1;
+      }
+      engines.push_back(*it);
+    }
+    else if (a == "--tolerance")
+    {
+      tolerance = value.toLongLong();
+    }
+    else if (a == "--json")
+    {
+      json_path = value;
+    }
+    else
+    {
+      cerr << "Unknown option: " << a << "." << Qt::endl;
+      return 1;
+    }
+  }
+
+  if (options.speed <= 0)
+  {
+    cerr << "Invalid speed." << Qt::endl;
+    return 1;
+  }
+
+  if (engines.empty())
+  {
+    engines.assign(std::begin(MatchingBenchmark::engines), std::end(MatchingBenchmark::engines));
+  }
+
+  cout << QString("episode").leftJustified(24) << QString("engine").leftJustified(12)
+       << QString("msecs").rightJustified(10) << QString("matches").rightJustified(9)
+       << QString("recall").rightJustified(9) << QString("precision").rightJustified(10) << Qt::endl;
+
+  QJsonArray jepisodes;
+
+  for (int seed(1); seed <= nb_seeds; ++seed)
+  {
+    const BenchEpisode episode = generateEpisode(options, seed);
+    jepisodes.append(MatchingBenchmark::run_episode(cout, episode, engines, tolerance));
+  }
+
+  for (const QString& path : episode_paths)
+  {
+    try
+    {
+      const BenchEpisode episode = loadEpisode(path);
+      jepisodes.append(MatchingBenchmark::run_episode(cout, episode, engines, tolerance));
+    }
+    catch (const std::exception& e)
+    {
+      cerr << e.what() << Qt::endl;
+      return 1;
+    }
+  }
+
+  if (!json_path.isEmpty())
+  {
+    QJsonObject synthetic;
+    synthetic["seeds"] = nb_seeds;
+    synthetic["scenes"] = options.scenes;
+    synthetic["deletions"] = options.deletions;
+    synthetic["insertions"] = options.insertions;
+    synthetic["speed"] = options.speed;
+    synthetic["fades"] = options.fades;
+    synthetic["noise"] = options.noise;
+
+    QJsonObject root;
+    root["benchmark"] = "matching";
+    root["version"] = QCoreApplication::applicationVersion();
+    root["hamming_kernel"] = hammingKernelName(hammingKernel());
+    root["threads"] = QThread::idealThreadCount();
+    root["tolerance"] = qint64(tolerance);
+    root["synthetic"] = synthetic;
+    root["episodes"] = jepisodes;
+
+    QFile file{json_path};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      cerr << "Could not write " << json_path << "." << Qt::endl;
+      return 1;
+    }
+
+    file.write(QJsonDocument(root).toJson());
+  }
+
+  return 0;
+}
+
+constexpr const char* CMD_RECORD_DESCRIPTION =
+    R"(Records an episode for the matching benchmark from a reviewed project:
+the frame hashes and detection results that were cached when creating
+the project are copied to the given directory, along with an episode.json
+manifest holding the matches of the project as ground truth.
+The videos of the project are only probed, so the project must have been
+created with `--detect-matches` on this machine.
+)";
+
+int bench_record(const QStringList& args)
+{
+  QTextStream cout{stdout};
+  QTextStream cerr{stderr};
+
+  if (helpRequested(args) || args.size() != 2)
+  {
+    cout << "BENCHMARK record" << Qt::endl;
+    cout << Qt::endl;
+    cout << "SYNTAX:" << Qt::endl;
+    cout << "  digidub-bench record project.txt directory" << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_RECORD_DESCRIPTION << Qt::endl;
+    return helpRequested(args) ? 0 : 1;
+  }
+
+  DubbingProject project;
+  if (!project.load(args.at(0)))
+  {
+    cerr << "Could not load project " << args.at(0) << "." << Qt::endl;
+    return 1;
+  }
+
+  try
+  {
+    cout << "Episode recorded to " << recordEpisode(project, args.at(1)) << Qt::endl;
+  }
+  catch (const std::exception& e)
+  {
+    cerr << e.what() << Qt::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+constexpr const char* CMD_FRAMES_DESCRIPTION =
+    R"(Compares the size of the frames files of the cache written with the
+raw and the packed encodings, and the time taken to load them (best of
+3 runs), on synthetic episodes and on the recorded episodes passed with
+`--episode` (see the record benchmark).
+OPTIONS:
+  --seeds N         number of synthetic episodes (default: 3)
+  --episode FILE    adds a recorded episode (episode.json)
+)";
+
+int bench_frames(const QStringList& args)
+{
+  QTextStream cout{stdout};
+  QTextStream cerr{stderr};
+
+  if (helpRequested(args))
+  {
+    cout << "BENCHMARK frames" << Qt::endl;
+    cout << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_FRAMES_DESCRIPTION << Qt::endl;
+    return 0;
+  }
+
+  int nb_seeds = 3;
+  QStringList episode_paths;
+
+  for (int i(0); i < args.size();)
+  {
+    const QString& a = args.at(i++);
+    if (i == args.size())
+    {
+      cerr << "Missing value after " << a << "." << Qt::endl;
+      return 1;
+    }
+
+    const QString& value = args.at(i++);
+
+    if (a == "--seeds")
+    {
+      nb_seeds = value.toInt();
+    }
+    else if (a == "--episode")
+    {
+      episode_paths.push_back(value);
+    }
+    else
+    {
+      cerr << "Unknown option: " << a << "." << Qt::endl;
+      return 1;
+    }
+  }
+
+  std::vector<BenchEpisode> episodes;
+
+  try
+  {
+    for (int seed(1); seed <= nb_seeds; ++seed)
+    {
+      episodes.push_back(generateEpisode(SyntheticEpisodeOptions(), seed));
+    }
+
+    for (const QString& path : episode_paths)
+    {
+      episodes.push_back(loadEpisode(path));
+    }
+  }
+  catch (const std::exception& e)
+  {
+    cerr << e.what() << Qt::endl;
+    return 1;
+  }
+
+  QTemporaryDir dir;
+  if (!dir.isValid())
+  {
+    cerr << "Could not create a temporary directory." << Qt::endl;
+    return 1;
+  }
+
+  cout << QString("video").leftJustified(24) << QString("frames").rightJustified(8)
+       << QString("raw").rightJustified(10) << QString("packed").rightJustified(10)
+       << QString("ratio").rightJustified(8) << QString("raw ms").rightJustified(10)
+       << QString("packed ms").rightJustified(10) << Qt::endl;
+
+  for (const BenchEpisode& episode : episodes)
+  {
+    for (const MediaObject* media : {episode.a.get(), episode.b.get()})
+    {
+      const FramesInfo& frames = *media->framesInfo();
+      qint64 sizes[2];
+      double times[2];
+
+      for (FramesInfo::Encoding encoding : {FramesInfo::Raw, FramesInfo::Packed})
+      {
+        const QString path = dir.filePath(QString::number(encoding) + ".frames");
+        if (!frames.save(path, media->frameRateAsRational(), QString(), encoding))
+        {
+          cerr << "Could not write " << path << "." << Qt::endl;
+          return 1;
+        }
+
+        sizes[encoding] = QFileInfo(path).size();
+        times[encoding] = HammingBenchmark::measure([&path]() { FramesInfo::load(path); });
+      }
+
+      cout << media->fileName().leftJustified(24) << QString::number(frames.size()).rightJustified(8)
+           << QString::number(sizes[FramesInfo::Raw]).rightJustified(10)
+           << QString::number(sizes[FramesInfo::Packed]).rightJustified(10)
+           << QString::number(sizes[FramesInfo::Raw] / double(sizes[FramesInfo::Packed]), 'f', 2).rightJustified(8)
+           << QString::number(times[FramesInfo::Raw], 'f', 3).rightJustified(10)
+           << QString::number(times[FramesInfo::Packed], 'f', 3).rightJustified(10) << Qt::endl;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  // same as digidub-cli, so that the cache directory is the same
+  QCoreApplication::setOrganizationName("Analogman Software");
+  QCoreApplication::setApplicationName("DigiDub");
+  QCoreApplication::setApplicationVersion(
+      QVersionNumber(DIGIDUB_VERSION_MAJOR, DIGIDUB_VERSION_MINOR).toString());
+
+  QCoreApplication app{argc, argv};
+
+  const QStringList args = app.arguments();
+
+  if (args.size() > 1)
+  {
+    if (args.at(1) == "hamming")
+    {
+      return bench_hamming(args.mid(2));
+    }
+    else if (args.at(1) == "hashindex")
+    {
+      return bench_hashindex(args.mid(2));
+    }
+    else if (args.at(1) == "matching")
+    {
+      return bench_matching(args.mid(2));
+    }
+    else if (args.at(1) == "record")
+    {
+      return bench_record(args.mid(2));
+    }
+    else if (args.at(1) == "frames")
+    {
+      return bench_frames(args.mid(2));
+    }
+    else if (!args.at(1).startsWith("-"))
+    {
+      QTextStream(stderr) << "Unknown benchmark " << args.at(1) << Qt::endl;
+      return 1;
+    }
+  }
+
+  QTextStream cout{stdout};
+  cout << "digidub-bench <benchmark> [arguments..]" << Qt::endl;
+  cout << Qt::endl;
+  cout << "Available benchmarks:" << Qt::endl;
+  cout << "  hamming   sliding-window kernels vs FFT" << Qt::endl;
+  cout << "  hashindex multi-index hashing vs linear scan" << Qt::endl;
+  cout << "  matching  speed and accuracy of the match detector on a corpus" << Qt::endl;
+  cout << "  record    records an episode of the corpus from a reviewed project" << Qt::endl;
+  cout << "  frames    size and loading time of the encodings of the frames files" << Qt::endl;
+  cout << Qt::endl;
+  cout << "Get more information about a benchmark using: digidub-bench <benchmark> --help" << Qt::endl;
+
+  return 0;
+}
@@ -2,9 +2,14 @@
 // This file is part of the 'digidub' project.
 // For conditions of distribution and use, see copyright notice in LICENSE.
 
+#include "cache.h"
 #include "exporter.h"
+#include "framesinfo.h"
 #include "matchalgo.h"
+#include "matchtrace.h"
 #include "mediaobject.h"
+#include "processpool.h"
+#include "profiler.h"
 #include "project.h"
 
 #include "blackdetectthread.h"
@@ -16,12 +21,15 @@
 #include <QEventLoop>
 #include <QThread>
 
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
 
 #include <QVersionNumber>
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
 static bool helpRequested(const QStringList& args)
@@ -127,6 +135,48 @@ static bool isYes(const std::string& text)
   return text == "y" || text == "yes";
 }
 
+// Writes the project to `savepath`, or to the standard output if it is empty.
+static int writeProject(QTextStream& cout,
+                        QTextStream& cerr,
+                        DubbingProject& project,
+                        const QString& savepath,
+                        bool force)
+{
+  if (!savepath.isEmpty())
+  {
+    QFile outfile{savepath};
+
+    if (outfile.exists() && !force)
+    {
+      cerr << "Output file already exists. Overwrite [y/N] ? " << Qt::flush;
+      std::string res;
+      std::cin >> res;
+      if (!isYes(res))
+      {
+        cerr << "Aborting." << Qt::endl;
+        return 0;
+      }
+    }
+
+    if (!outfile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      cerr << "Could not open output file for writing." << Qt::endl;
+      return 1;
+    }
+
+    cerr << "Writing output file " << savepath << Qt::endl;
+
+    QTextStream stream{&outfile};
+    project.dump(stream);
+  }
+  else
+  {
+    project.dump(cout);
+  }
+
+  return 0;
+}
+
 constexpr const char* CMD_CREATE_DESCRIPTION =
     R"(Creates a project from the given inputs and options.
 If an output file [project.txt] is provided, the result
@@ -138,6 +188,11 @@ Input files are provided with `-i` and may be:
 - a subtitle file (*.srt)
 If the `--detect-matches` option is passed, the program will
 perform match detection between the two video files.
+With `--candidates N`, the N best matches of each scene
+are also stored in the project, so that the editor can
+offer them as alternatives.
+With `--match-trace trace.jsonl`, the steps of the match
+detection are written to a JSON lines file.
 The `--title` option may be used to specify a title for the
 project.
 The `--output` option may be used to specify an output file
@@ -168,6 +223,8 @@ int cmd_create(QStringList args)
   QStringList inputs;
   QString savepath;
   bool detect_matches = false;
+  int nb_candidates = 0;
+  QString match_trace_path;
   bool force = false;
 
   for (int i(0); i < args.size();)
@@ -191,6 +248,14 @@ int cmd_create(QStringList args)
       {
         detect_matches = true;
       }
+      else if (a == "--candidates")
+      {
+        nb_candidates = args.at(i++).toInt();
+      }
+      else if (a == "--match-trace")
+      {
+        match_trace_path = args.at(i++);
+      }
       else if (a == "-y")
       {
         force = true;
@@ -293,9 +358,19 @@ int cmd_create(QStringList args)
     CreateCommand::loadAllData(cerr, video1, video2);
 
     MatchDetector detector{video1, video2};
+    detector.parameters.candidateMatches = nb_candidates;
+
+    if (!match_trace_path.isEmpty()
+        && !MatchAlgo::startTrace(match_trace_path, MatchAlgo::TraceLevel::Scenes))
+    {
+      cerr << "Could not open trace file " << match_trace_path << "." << Qt::endl;
+      return 1;
+    }
 
     std::vector<VideoMatch> matches = detector.run();
+    MatchAlgo::stopTrace();
     project.addMatches(matches);
+    project.setCandidates(detector.candidates());
   }
 
   if (project.projectTitle().isEmpty())
@@ -303,41 +378,428 @@ int cmd_create(QStringList args)
     project.setProjectTitle(QFileInfo(project.videoFilePath()).fileName());
   }
 
-  if (!savepath.isEmpty())
+  return writeProject(cout, cerr, project, savepath, force);
+}
+
+namespace MatchCommand {
+
+struct Engine
+{
+  const char* name;
+  MatchAlgo::MatchEngine engine;
+};
+
+constexpr Engine engines[] = {
+    {"exhaustive", MatchAlgo::MatchEngine::Exhaustive},
+    {"seed", MatchAlgo::MatchEngine::SeedAndExtend},
+    {"align", MatchAlgo::MatchEngine::GlobalAlignment},
+    {"warp", MatchAlgo::MatchEngine::TimeWarp},
+};
+
+} // namespace MatchCommand
+
+constexpr const char* CMD_MATCH_DESCRIPTION =
+    R"(Runs the match detection between the two videos of a project,
+replacing its matches.
+If an output file [output.txt] is provided, the result is
+written to that file, otherwise the project file is printed
+to the standard output.
+With `--from-cache`, the frames and the detections are read
+from the files cached by a previous analysis of the videos,
+which are neither read nor probed (they may not even exist);
+the detection then runs without starting any process.
+Options:
+  --from-cache          only use the cached analysis
+  --engine NAME         exhaustive (default), seed, align or warp
+  --candidates N        also keep the N best matches of each
+                        scene
+  --match-trace FILE    write the steps of the detection to a
+                        JSON lines file
+  -y                    overwrite the output file without warning
+)";
+
+int cmd_match(QStringList args)
+{
+  QTextStream cout{stdout};
+  QTextStream cerr{stderr};
+
+  if (helpRequested(args) || args.isEmpty())
   {
-    QFile outfile{savepath};
+    cout << "COMMAND match" << Qt::endl;
+    cout << Qt::endl;
+    cout << "SYNTAX:" << Qt::endl;
+    cout << "  digidub match [options] project.txt [output.txt]" << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_MATCH_DESCRIPTION << Qt::endl;
+    return 0;
+  }
 
-    if (outfile.exists() && !force)
+  QStringList paths;
+  bool from_cache = false;
+  MatchAlgo::Parameters parameters;
+  QString match_trace_path;
+  bool force = false;
+
+  for (int i(0); i < args.size();)
+  {
+    const QString& a = args.at(i++);
+    if (a == "--from-cache")
     {
-      cerr << "Output file already exists. Overwrite [y/N] ? " << Qt::flush;
-      std::string res;
-      std::cin >> res;
-      if (!isYes(res))
+      from_cache = true;
+    }
+    else if (a == "--engine" && i < args.size())
+    {
+      const QString& name = args.at(i++);
+      auto it = std::find_if(std::begin(MatchCommand::engines),
+                             std::end(MatchCommand::engines),
+                             [&name](const MatchCommand::Engine& e) { return name == e.name; });
+      if (it == std::end(MatchCommand::engines))
       {
-        cerr << "Aborting." << Qt::endl;
-        return 0;
+        cerr << "Unknown engine: " << name << "." << Qt::endl;
+        return 1;
       }
+      parameters.engine = it->engine;
     }
-
-    if (!outfile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    else if (a == "--candidates" && i < args.size())
     {
-      cerr << "Could not open output file for writing." << Qt::endl;
+      parameters.candidateMatches = args.at(i++).toInt();
+    }
+    else if (a == "--match-trace" && i < args.size())
+    {
+      match_trace_path = args.at(i++);
+    }
+    else if (a == "-y")
+    {
+      force = true;
+    }
+    else if (a.startsWith("-"))
+    {
+      cerr << "Unknown option: " << a << "." << Qt::endl;
       return 1;
     }
+    else
+    {
+      paths.push_back(a);
+    }
+  }
 
-    cerr << "Writing output file " << savepath << Qt::endl;
+  if (paths.isEmpty() || paths.size() > 2)
+  {
+    cerr << "Expected a project file and an optional output file." << Qt::endl;
+    return 1;
+  }
 
-    QTextStream stream{&outfile};
-    project.dump(stream);
+  DubbingProject project;
+  if (!project.load(paths.front()))
+  {
+    cerr << "Could not load project " << paths.front() << "." << Qt::endl;
+    return 1;
   }
-  else
+
+  std::unique_ptr<MediaObject> video1;
+  std::unique_ptr<MediaObject> video2;
+
+  try
   {
-    project.dump(cout);
+    if (from_cache)
+    {
+      video1 = MediaObject::fromCache(project.resolvePath(project.videoFilePath()));
+      video2 = MediaObject::fromCache(project.resolvePath(project.audioSourceFilePath()));
+
+      if (!video1->silenceInfo() || !video1->blackFramesInfo() || !video1->scenesInfo())
+      {
+        cerr << "The detections of " << video1->fileName() << " are not in the cache." << Qt::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      video1 = std::make_unique<MediaObject>(project.resolvePath(project.videoFilePath()));
+      video2 = std::make_unique<MediaObject>(project.resolvePath(project.audioSourceFilePath()));
+      CreateCommand::loadAllData(cerr, *video1, *video2);
+    }
+  }
+  catch (const std::exception& e)
+  {
+    cerr << e.what() << Qt::endl;
+    return 1;
   }
 
-  return 0;
+  MatchDetector detector{*video1, *video2};
+  detector.parameters = parameters;
+
+  if (!match_trace_path.isEmpty()
+      && !MatchAlgo::startTrace(match_trace_path, MatchAlgo::TraceLevel::Scenes))
+  {
+    cerr << "Could not open trace file " << match_trace_path << "." << Qt::endl;
+    return 1;
+  }
+
+  const std::vector<VideoMatch> matches = detector.run();
+  MatchAlgo::stopTrace();
+
+  for (MatchObject* m : std::vector<MatchObject*>(project.matches()))
+  {
+    project.removeMatch(m);
+  }
+  project.addMatches(matches);
+  project.setCandidates(detector.candidates());
+
+  cerr << matches.size() << " matches found." << Qt::endl;
+
+  return writeProject(cout, cerr, project, paths.size() > 1 ? paths.back() : QString(), force);
 }
 
+namespace ExportCommand {
+
+struct Job
+{
+  int index = 0;
+  QString projectFilePath;
+  std::unique_ptr<DubbingProject> project;
+  std::unique_ptr<MediaObject> video;
+  std::unique_ptr<DubExporter> exporter;
+  bool finished = false;
+};
+
+// Expands wildcards in the inputs, as not all shells do it for us.
+QStringList expandInputs(const QStringList& inputs)
+{
+  QStringList result;
+
+  for (const QString& input : inputs)
+  {
+    if (!input.contains('*') && !input.contains('?') && !input.contains('['))
+    {
+      result.push_back(input);
+      continue;
+    }
+
+    const QFileInfo info{input};
+    const QDir dir = info.dir();
+    for (const QString& name : dir.entryList(QStringList() << info.fileName(), QDir::Files, QDir::Name))
+    {
+      result.push_back(dir.filePath(name));
+    }
+  }
+
+  return result;
+}
+
+// An output is up to date if it is newer than the project and all its inputs.
+bool isUpToDate(const DubbingProject& project)
+{
+  const QFileInfo output{project.resolvePath(project.outputFilePath())};
+  if (!output.exists())
+  {
+    return false;
+  }
+
+  for (const QString& path : {project.projectFilePath(),
+                              project.resolvePath(project.videoFilePath()),
+                              project.resolvePath(project.audioSourceFilePath()),
+                              project.resolvePath(project.subtitlesFilePath())})
+  {
+    if (path.isEmpty())
+    {
+      continue;
+    }
+
+    const QFileInfo input{path};
+    if (input.exists() && input.lastModified() > output.lastModified())
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+float globalProgress(const std::vector<std::unique_ptr<Job>>& jobs)
+{
+  float p = 0;
+
+  for (const auto& job : jobs)
+  {
+    if (job->finished)
+    {
+      p += 1;
+    }
+    else if (job->exporter)
+    {
+      p += job->exporter->progress();
+    }
+  }
+
+  return jobs.empty() ? 1 : p / jobs.size();
+}
+
+int exportProjects(QTextStream& cerr,
+                   const QStringList& projectFiles,
+                   int nbJobs,
+                   bool force,
+                   bool printReport)
+{
+  std::vector<std::unique_ptr<Job>> jobs;
+  int nb_errors = 0;
+
+  for (const QString& path : projectFiles)
+  {
+    auto job = std::make_unique<Job>();
+    job->projectFilePath = path;
+    job->project = std::make_unique<DubbingProject>();
+
+    if (!job->project->load(path))
+    {
+      cerr << "Error: could not load project " << path << "." << Qt::endl;
+      ++nb_errors;
+      continue;
+    }
+
+    if (job->project->outputFilePath().isEmpty())
+    {
+      cerr << "Error: project " << path << " has no output file." << Qt::endl;
+      ++nb_errors;
+      continue;
+    }
+
+    if (!force && isUpToDate(*job->project))
+    {
+      cerr << "Skipping " << path << " (up to date)." << Qt::endl;
+      continue;
+    }
+
+    job->index = int(jobs.size()) + 1;
+    jobs.push_back(std::move(job));
+  }
+
+  if (jobs.empty())
+  {
+    return nb_errors == 0 ? 0 : 1;
+  }
+
+  // All the exporters share the same pool, so the number of ffmpeg processes
+  // is bounded no matter how many projects are exported.
+  // We also limit the number of projects being exported at the same time, to
+  // bound the disk space used by temporary files.
+  ProcessPool pool{nbJobs};
+  const size_t max_active_jobs = std::max(1, nbJobs);
+  size_t next_job = 0;
+  size_t nb_active_jobs = 0;
+  size_t nb_finished_jobs = 0;
+
+  QEventLoop loop;
+
+  auto print_progress = [&](const Job& job) {
+    cerr << "[" << job.index << "/" << jobs.size() << "] " << job.project->projectTitle() << ": "
+         << job.exporter->status() << " (" << int(100 * job.exporter->progress()) << "%), total "
+         << int(100 * globalProgress(jobs)) << "%" << Qt::endl;
+  };
+
+  std::function<void()> start_jobs;
+
+  auto on_job_finished = [&](Job& job) {
+    job.finished = true;
+    --nb_active_jobs;
+    ++nb_finished_jobs;
+
+    if (!job.exporter->succeeded())
+    {
+      cerr << "Error: could not export " << job.projectFilePath << "." << Qt::endl;
+      ++nb_errors;
+    }
+    else if (printReport)
+    {
+      QTextStream cout{stdout};
+      cout << job.exporter->report().summary() << Qt::flush;
+    }
+
+    start_jobs();
+
+    if (nb_finished_jobs == jobs.size())
+    {
+      loop.quit();
+    }
+  };
+
+  start_jobs = [&]() {
+    while (nb_active_jobs < max_active_jobs && next_job < jobs.size())
+    {
+      Job& job = *jobs.at(next_job++);
+      DubbingProject& project = *job.project;
+
+      cerr << "Exporting " << job.projectFilePath << " to "
+           << project.resolvePath(project.outputFilePath()) << Qt::endl;
+
+      try
+      {
+        job.video = std::make_unique<MediaObject>(project.resolvePath(project.videoFilePath()));
+      } catch (const std::runtime_error& ex)
+      {
+        cerr << "Error: could not open video of " << job.projectFilePath << ": " << ex.what()
+             << Qt::endl;
+        job.finished = true;
+        ++nb_finished_jobs;
+        ++nb_errors;
+        continue;
+      }
+
+      job.exporter = std::make_unique<DubExporter>(project, *job.video);
+      job.exporter->setProcessPool(&pool);
+
+      QObject::connect(job.exporter.get(), &DubExporter::statusChanged, [&print_progress, &job]() {
+        if (job.exporter->isRunning())
+        {
+          print_progress(job);
+        }
+      });
+
+      QObject::connect(job.exporter.get(),
+                       &DubExporter::finished,
+                       &loop,
+                       [&on_job_finished, &job]() { on_job_finished(job); },
+                       Qt::QueuedConnection);
+
+      ++nb_active_jobs;
+      job.exporter->run();
+
+      if (!job.exporter->isRunning())
+      {
+        cerr << "Error: could not start export of " << job.projectFilePath << "." << Qt::endl;
+        job.finished = true;
+        --nb_active_jobs;
+        ++nb_finished_jobs;
+        ++nb_errors;
+      }
+    }
+  };
+
+  start_jobs();
+
+  if (nb_finished_jobs < jobs.size())
+  {
+    loop.exec();
+  }
+
+  return nb_errors == 0 ? 0 : 1;
+}
+
+} // namespace ExportCommand
+
+constexpr const char* CMD_EXPORT_DESCRIPTION =
+    R"(Exports one or more projects.
+Inputs may contain wildcards (e.g. `season1/*.txt`).
+Projects whose output file is newer than the project file
+and its inputs are skipped, so an interrupted batch can
+simply be run again; pass `--force` to export them anyway.
+All the projects share a single pool of worker processes,
+whose size can be set with `--jobs` (defaults to the
+number of cores).
+A JSON report with the time spent in each step and
+segment is written next to each output file; pass
+`--report` to also print a summary of it.
+)";
+
 int cmd_export(QStringList args)
 {
   QTextStream cout{stdout};
@@ -345,27 +807,255 @@ int cmd_export(QStringList args)
 
   if (helpRequested(args) || args.isEmpty())
   {
-    cout << "digidub export project.txt" << Qt::endl;
+    cout << "COMMAND export" << Qt::endl;
+    cout << Qt::endl;
+    cout << "SYNTAX:" << Qt::endl;
+    cout << "  digidub export [options] project.txt [project2.txt...]" << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_EXPORT_DESCRIPTION << Qt::endl;
     return 0;
   }
 
-  QString inputpath;
+  QStringList inputs;
+  int nb_jobs = QThread::idealThreadCount();
+  bool force = false;
+  bool report = false;
 
-  if (args.size() != 1)
+  for (int i(0); i < args.size();)
   {
-    cerr << "invalid number of arguments" << Qt::endl;
+    const QString& a = args.at(i++);
+    if (a.startsWith("-"))
+    {
+      if (a == "--jobs" || a == "-j")
+      {
+        bool ok = false;
+        nb_jobs = i < args.size() ? args.at(i++).toInt(&ok) : 0;
+        if (!ok || nb_jobs < 1)
+        {
+          cerr << "Invalid number of jobs." << Qt::endl;
+          return 1;
+        }
+      }
+      else if (a == "--force" || a == "-f")
+      {
+        force = true;
+      }
+      else if (a == "--report")
+      {
+        report = true;
+      }
+      else
+      {
+        cerr << "Unknown option: " << a << "." << Qt::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      inputs.push_back(a);
+    }
+  }
+
+  inputs = ExportCommand::expandInputs(inputs);
+
+  if (inputs.empty())
+  {
+    cerr << "No project to export." << Qt::endl;
+    return 1;
+  }
+
+  return ExportCommand::exportProjects(cerr, inputs, nb_jobs, force, report);
+}
+
+namespace ArchiveCommand {
+
+// Writes the cached frames of the videos of the projects as packed files,
+// named after the fingerprint of their video.
+int packFrames(QTextStream& cerr, const QStringList& projectFiles, const QString& archiveDir)
+{
+  if (!QDir().mkpath(archiveDir))
+  {
+    cerr << "Error: could not create directory " << archiveDir << "." << Qt::endl;
     return 1;
   }
 
-  inputpath = args[0];
+  int nb_errors = 0;
+  QStringList written;
 
-  DubbingProject project{inputpath};
+  for (const QString& path : projectFiles)
+  {
+    DubbingProject project;
+    if (!project.load(path))
+    {
+      cerr << "Error: could not load project " << path << "." << Qt::endl;
+      ++nb_errors;
+      continue;
+    }
 
-  MediaObject video{project.videoFilePath()};
+    for (const QString& video :
+         {project.resolvePath(project.videoFilePath()), project.resolvePath(project.audioSourceFilePath())})
+    {
+      if (video.isEmpty())
+      {
+        continue;
+      }
 
-  exportProject(project, video);
+      // the video may have been deleted since its frames were extracted
+      const QString fingerprint =
+          QFileInfo::exists(video) ? GetMediaFingerprint(video) : FindMediaFingerprint(video);
 
-  return 0;
+      if (fingerprint.isEmpty())
+      {
+        cerr << "Error: no fingerprint for " << video << "." << Qt::endl;
+        ++nb_errors;
+        continue;
+      }
+
+      if (written.contains(fingerprint))
+      {
+        continue;
+      }
+
+      std::unique_ptr<FramesInfo> frames =
+          FramesInfo::load(FrameExtractionThread::cacheFilePath(fingerprint), fingerprint);
+      const QString archive_path = QDir(archiveDir).filePath(fingerprint + ".frames");
+
+      if (!frames || !frames->save(archive_path, frames->frameRate(), fingerprint, FramesInfo::Packed))
+      {
+        cerr << "Error: could not archive the frames of " << video << "." << Qt::endl;
+        ++nb_errors;
+        continue;
+      }
+
+      cerr << "Archived the frames of " << video << " as " << archive_path << Qt::endl;
+      written.push_back(fingerprint);
+    }
+  }
+
+  return nb_errors == 0 ? 0 : 1;
+}
+
+// Decodes the packed files of an archive back into the cache,
+// where they are stored raw so that they can be mapped.
+int restoreFrames(QTextStream& cerr, const QString& archiveDir, bool force)
+{
+  const QDir dir{archiveDir};
+  if (!dir.exists())
+  {
+    cerr << "Error: no directory " << archiveDir << "." << Qt::endl;
+    return 1;
+  }
+
+  CreateCacheDir();
+
+  int nb_errors = 0;
+
+  for (const QString& name : dir.entryList(QStringList() << "*.frames", QDir::Files, QDir::Name))
+  {
+    const QString fingerprint = QFileInfo(name).completeBaseName();
+    const QString cache_path = FrameExtractionThread::cacheFilePath(fingerprint);
+
+    if (!force && QFileInfo::exists(cache_path))
+    {
+      continue;
+    }
+
+    std::unique_ptr<FramesInfo> frames = FramesInfo::load(dir.filePath(name), fingerprint);
+
+    if (!frames || !frames->save(cache_path, frames->frameRate(), fingerprint, FramesInfo::Raw))
+    {
+      cerr << "Error: could not restore " << dir.filePath(name) << "." << Qt::endl;
+      ++nb_errors;
+      continue;
+    }
+
+    cerr << "Restored " << dir.filePath(name) << Qt::endl;
+  }
+
+  return nb_errors == 0 ? 0 : 1;
+}
+
+} // namespace ArchiveCommand
+
+constexpr const char* CMD_ARCHIVE_DESCRIPTION =
+    R"(Archives the frames extracted from the videos of one
+or more projects, or restores them.
+The frames are cached in a raw format, which is mapped
+rather than read, but takes several times the space of
+the packed format used by the archive. Archiving a season
+keeps its analyses small enough to be stored or moved to
+another machine, where `--restore` puts them back into the
+cache so that the videos do not have to be decoded again.
+Inputs may contain wildcards (e.g. `season1/*.txt`).
+Frames already in the cache are not restored again unless
+`--force` is passed.
+)";
+
+int cmd_archive(QStringList args)
+{
+  QTextStream cout{stdout};
+  QTextStream cerr{stderr};
+
+  if (helpRequested(args) || args.isEmpty())
+  {
+    cout << "COMMAND archive" << Qt::endl;
+    cout << Qt::endl;
+    cout << "SYNTAX:" << Qt::endl;
+    cout << "  digidub archive --output <dir> project.txt [project2.txt...]" << Qt::endl;
+    cout << "  digidub archive --restore <dir> [--force]" << Qt::endl;
+    cout << "DESCRIPTION:" << Qt::endl;
+    cout << CMD_ARCHIVE_DESCRIPTION << Qt::endl;
+    return 0;
+  }
+
+  QStringList inputs;
+  QString archive_dir;
+  QString restore_dir;
+  bool force = false;
+
+  for (int i(0); i < args.size();)
+  {
+    const QString& a = args.at(i++);
+    if (a.startsWith("-"))
+    {
+      if ((a == "--output" || a == "-o") && i < args.size())
+      {
+        archive_dir = args.at(i++);
+      }
+      else if (a == "--restore" && i < args.size())
+      {
+        restore_dir = args.at(i++);
+      }
+      else if (a == "--force" || a == "-f")
+      {
+        force = true;
+      }
+      else
+      {
+        cerr << "Unknown option: " << a << "." << Qt::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      inputs.push_back(a);
+    }
+  }
+
+  if (!restore_dir.isEmpty())
+  {
+    return ArchiveCommand::restoreFrames(cerr, restore_dir, force);
+  }
+
+  inputs = ExportCommand::expandInputs(inputs);
+
+  if (archive_dir.isEmpty() || inputs.empty())
+  {
+    cerr << "An output directory and at least one project are required." << Qt::endl;
+    return 1;
+  }
+
+  return ArchiveCommand::packFrames(cerr, inputs, archive_dir);
 }
 
 int main(int argc, char* argv[])
@@ -377,17 +1067,53 @@ int main(int argc, char* argv[])
 
   QCoreApplication app{argc, argv};
 
-  const QStringList args = app.arguments();
+  QStringList args = app.arguments();
+
+  // global option, which may be placed anywhere on the command line
+  const qsizetype trace_index = args.indexOf("--trace");
+  if (trace_index != -1)
+  {
+    if (trace_index + 1 >= args.size())
+    {
+      std::cerr << "Missing file name after --trace" << std::endl;
+      return 1;
+    }
+
+    startProfiling(args.at(trace_index + 1));
+    args.remove(trace_index, 2);
+  }
 
   if (args.size() > 1)
   {
+    std::function<int(QStringList)> command;
     if (args.at(1) == "create")
     {
-      return cmd_create(args.mid(2));
+      command = cmd_create;
+    }
+    else if (args.at(1) == "match")
+    {
+      command = cmd_match;
     }
     else if (args.at(1) == "export")
     {
-      return cmd_export(args.mid(2));
+      command = cmd_export;
+    }
+    else if (args.at(1) == "archive")
+    {
+      command = cmd_archive;
+    }
+
+    if (command)
+    {
+      const int result = command(args.mid(2));
+
+      if (!stopProfiling())
+      {
+        std::cerr << "Could not write trace file" << std::endl;
+        return 1;
+      }
+
+      return result;
     }
     else if (!args.at(1).startsWith("-"))
     {
@@ -403,7 +1129,13 @@ int main(int argc, char* argv[])
     cout << Qt::endl;
     cout << "Available commands:" << Qt::endl;
     cout << "  create    create a project" << Qt::endl;
+    cout << "  match     detect the matches of a project" << Qt::endl;
     cout << "  export    export a project" << Qt::endl;
+    cout << "  archive   archive or restore the frames of projects" << Qt::endl;
+    cout << Qt::endl;
+    cout << "Global options:" << Qt::endl;
+    cout << "  --trace <file.json>  write a Chrome trace event file of where the time goes" << Qt::endl;
+    cout << "                       (open it with https://ui.perfetto.dev)" << Qt::endl;
     cout << Qt::endl;
     cout << "Get more information about a command using: digidub <command> --help" << Qt::endl;
   }
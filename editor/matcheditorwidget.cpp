@@ -1,6 +1,7 @@
 #include "matcheditorwidget.h"
 
 #include "commands.h"
+#include "matchpreviewplayer.h"
 #include "videoplayerwidget.h"
 #include "window.h"
 
@@ -13,6 +14,7 @@
 #include "cache.h"
 #include "exerun.h"
 
+#include <QMessageBox>
 #include <QProgressDialog>
 
 #include <QLabel>
@@ -63,7 +65,7 @@ public:
     Q_ASSERT(m_media.framesInfo());
     if (m_media.framesInfo())
     {
-      m_icons.resize(m_media.framesInfo()->frames.size());
+      m_icons.resize(m_media.framesInfo()->size());
     }
     else
     {
@@ -87,7 +89,7 @@ public:
     case Qt::DisplayRole: {
       if (m_media.framesInfo())
       {
-        return QString::number(m_media.framesInfo()->frames.at(i).pts);
+        return QString::number(m_media.framesInfo()->pts()[i]);
       }
       return "#" + QString::number(i);
     }
@@ -106,7 +108,7 @@ public:
         return QVariant();
       }
       const auto d = Duration(
-          std::round(m_media.framesInfo()->frames.at(i).pts * m_media.frameDelta() * 1000));
+          std::round(m_media.framesInfo()->pts()[i] * m_media.frameDelta() * 1000));
       return d.toString(Duration::HHMMSSzzz);
     }
     case Qt::BackgroundRole: {
@@ -201,11 +203,11 @@ protected Q_SLOTS:
     MiniatureRequest& req = *it;
     req.process = nullptr;
 
-    const std::vector<VideoFrameInfo>& frames = m_media.framesInfo()->frames;
+    const std::span<const int> pts = m_media.framesInfo()->pts();
 
     for (int i(req.min); i <= req.max; ++i)
     {
-      const QString filename = outdir.filePath(QString::number(frames[i].pts) + ".jpeg");
+      const QString filename = outdir.filePath(QString::number(pts[i]) + ".jpeg");
       m_icons[i] = QIcon(filename);
     }
 
@@ -230,24 +232,24 @@ private:
     }
 
     const double framedelta = m_media.frameDelta();
-    const std::vector<VideoFrameInfo>& frames = m_media.framesInfo()->frames;
-    auto it = std::lower_bound(frames.begin(),
-                               frames.end(),
+    const std::span<const int> pts = m_media.framesInfo()->pts();
+    auto it = std::lower_bound(pts.begin(),
+                               pts.end(),
                                m_match.start(),
-                               [framedelta](const VideoFrameInfo& e, int64_t time) {
-                                 return std::round(e.pts * framedelta * 1000) < time;
+                               [framedelta](int e, int64_t time) {
+                                 return std::round(e * framedelta * 1000) < time;
                                });
 
-    m_matchRange.first = std::distance(frames.begin(), it);
+    m_matchRange.first = std::distance(pts.begin(), it);
 
     it = std::lower_bound(it,
-                          frames.end(),
+                          pts.end(),
                           m_match.end(),
-                          [framedelta](const VideoFrameInfo& e, int64_t time) {
-                            return std::round(e.pts * framedelta * 1000) < time;
+                          [framedelta](int e, int64_t time) {
+                            return std::round(e * framedelta * 1000) < time;
                           });
 
-    m_matchRange.second = std::distance(frames.begin(), std::prev(it));
+    m_matchRange.second = std::distance(pts.begin(), std::prev(it));
 
     Q_EMIT dataChanged(index(0), index(m_icons.size() - 1), QList<int>{Qt::BackgroundRole});
   }
@@ -256,9 +258,9 @@ private:
   {
     Q_ASSERT(m_media.framesInfo());
 
-    const std::vector<VideoFrameInfo>& frames = m_media.framesInfo()->frames;
-    m_match = TimeSegment(m_media.convertPtsToPosition(frames[m_matchRange.first].pts),
-                          m_media.convertPtsToPosition(frames[m_matchRange.second].pts + 1));
+    const std::span<const int> pts = m_media.framesInfo()->pts();
+    m_match = TimeSegment(m_media.convertPtsToPosition(pts[m_matchRange.first]),
+                          m_media.convertPtsToPosition(pts[m_matchRange.second] + 1));
 
     qDebug() << "new match segment:" << m_match;
   }
@@ -289,7 +291,7 @@ private:
       }
     }
 
-    const std::vector<VideoFrameInfo>& frames = m_media.framesInfo()->frames;
+    const std::span<const int> pts = m_media.framesInfo()->pts();
 
 // TODO: adapter le nombre de frames à récupérer en fonction de la taille des miniatures ?
 #ifndef NDEBUG
@@ -298,7 +300,7 @@ private:
     constexpr double nsecs = 20;
 #endif
     size_t min_index = std::max<int>(0, frameIndex - 0.5 * nsecs / m_media.frameDelta());
-    size_t max_index = std::min<int>(frames.size() - 1,
+    size_t max_index = std::min<int>(pts.size() - 1,
                                      frameIndex + 0.5 * nsecs / m_media.frameDelta());
 
     // Adjust min_index and max_index so as not to request the same frames multiple times
@@ -309,7 +311,7 @@ private:
     //   ++max_index;
     // }
 
-    // max_index = std::min(frames.size() - 1, max_index);
+    // max_index = std::min(pts.size() - 1, max_index);
     // while (!m_icons[max_index].isNull())
     // {
     //   --max_index;
@@ -333,8 +335,8 @@ private:
     req.min = min_index;
     req.max = max_index;
 
-    const auto seg = TimeSegment(frames.at(min_index).pts * m_media.frameDelta() * 1000,
-                                 (frames.at(max_index).pts + 1) * m_media.frameDelta() * 1000);
+    const auto seg = TimeSegment(pts[min_index] * m_media.frameDelta() * 1000,
+                                 (pts[max_index] + 1) * m_media.frameDelta() * 1000);
 
     // ffmpeg -ss 20 -to 30 -i 3.mkv -vsync 0 -vf scale=64:64 -copyts -f image2 -frame_pts true frames/%d.jpeg
 
@@ -501,29 +503,28 @@ public Q_SLOTS:
     MediaObject* media = m_player.media();
 
     const double framedelta = media->frameDelta();
-    const std::vector<VideoFrameInfo>& frames = media->framesInfo()->frames;
-    auto it = std::lower_bound(frames.begin(),
-                               frames.end(),
+    const std::span<const int> pts = media->framesInfo()->pts();
+    auto it = std::lower_bound(pts.begin(),
+                               pts.end(),
                                pos,
-                               [framedelta](const VideoFrameInfo& e, int64_t time) {
-                                 return std::round(e.pts * framedelta * 1000) < time;
+                               [framedelta](int e, int64_t time) {
+                                 return std::round(e * framedelta * 1000) < time;
                                });
 
-    if (it == frames.end())
+    if (it == pts.end())
     {
       return;
     }
 
-    if (it != frames.begin())
+    if (it != pts.begin())
     {
-      const VideoFrameInfo& frame = *it;
-      if (std::round(frame.pts * framedelta * 1000) > pos)
+      if (std::round(*it * framedelta * 1000) > pos)
       {
         it = std::prev(it);
       }
     }
 
-    int n = std::distance(frames.begin(), it);
+    int n = std::distance(pts.begin(), it);
 
     scrollTo(model()->index(n));
     setCurrentIndex(model()->index(n));
@@ -568,8 +569,7 @@ protected Q_SLOTS:
     }
 
     const MediaObject& media = *m_player.media();
-    const VideoFrameInfo& frame = media.framesInfo()->frames.at(i);
-    int64_t pos = media.convertPtsToPosition(frame.pts);
+    int64_t pos = media.convertPtsToPosition(media.framesInfo()->pts()[i]);
     auto* w = qobject_cast<MainWindow*>(window());
 
     if (w)
@@ -611,14 +611,14 @@ protected:
       return;
     }
 
-    const std::vector<VideoFrameInfo>& frames = m.framesInfo()->frames;
+    const std::span<const int> pts = m.framesInfo()->pts();
 
-    if (i < 0 || i >= frames.size())
+    if (i < 0 || i >= pts.size())
     {
       return;
     }
 
-    m_player.seek(std::round((frames[i].pts + 0.5) * m.frameDelta() * 1000));
+    m_player.seek(std::round((pts[i] + 0.5) * m.frameDelta() * 1000));
   }
 
 private:
@@ -755,7 +755,8 @@ static QString PREVIOUS_MATCH_LABEL = "< Previous";
 static QString NEXT_MATCH_LABEL = "Next >";
 static QString PREVIOUS_MATCH_LINK = "<a href=\"action:previous\">&lt; Previous</a>";
 static QString NEXT_MATCH_LINK = "<a href=\"action:next\">Next &gt;</a>";
-static QString PREVIEW_LINK = "<a href=\"action:preview\">Preview</a>";
+static QString PREVIEW_LINK =
+    "<a href=\"action:preview\">Preview</a> (<a href=\"action:external-preview\">external</a>)";
 
 MatchEditorWidget::MatchEditorWidget(DubbingProject& project,
                                      MediaObject& video1,
@@ -786,6 +787,8 @@ MatchEditorWidget::MatchEditorWidget(DubbingProject& project,
       m_leftPlayer->setMedia(&video1);
       m_rightPlayer->setMedia(&video2);
 
+      m_previewPlayer = new MatchPreviewPlayer(*m_leftPlayer, this);
+
       splitter->addWidget(playersrow);
     }
 
@@ -946,6 +949,31 @@ MatchEditorWidget::SelectionRange MatchEditorWidget::getSelectionRange(
   return res;
 }
 
+// Plays the match in the left player, with the (stretched) audio of the right video.
+void MatchEditorWidget::playPreview()
+{
+  if (m_previewPlayer->isPlaying())
+  {
+    m_previewPlayer->stop();
+    return;
+  }
+
+  VideoMatch match;
+  match.a = m_items[0]->framesView->matchRange();
+  match.b = m_items[1]->framesView->matchRange();
+
+  const MediaObject& audio_source = *m_items[1]->framesView->videoPlayer().media();
+
+  if (!m_previewPlayer->play(match, audio_source))
+  {
+    const QString reason = audio_source.audioInfo()
+                               ? "the match is empty, its audio could not be read, or there is no audio output."
+                               : "the audio of the second video has not been extracted yet.";
+    QMessageBox::information(this, "Preview", "Could not play the preview: " + reason);
+  }
+}
+
+// Produces a video file of the match and opens it with the default video player.
 void MatchEditorWidget::launchPreview()
 {
   if (!m_items[1]->framesView->videoPlayer().media()->audioInfo())
@@ -1041,6 +1069,10 @@ void MatchEditorWidget::launchPreview()
 void MatchEditorWidget::onLinkActivated(const QString& link)
 {
   if (link == "action:preview")
+  {
+    playPreview();
+  }
+  else if (link == "action:external-preview")
   {
     launchPreview();
   }
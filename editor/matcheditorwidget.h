@@ -19,6 +19,7 @@ class MatchObject;
 class MediaObject;
 
 class MatchEditorItemWidget;
+class MatchPreviewPlayer;
 class VideoPlayerWidget;
 
 class MatchEditorWidget : public QWidget
@@ -55,6 +56,7 @@ public:
   std::pair<SelectionRange, SelectionRange> selectedRanges() const;
 
 public Q_SLOTS:
+  void playPreview();
   void launchPreview();
 
 protected Q_SLOTS:
@@ -73,6 +75,7 @@ private:
   MediaObject& m_video2;
   VideoPlayerWidget* m_leftPlayer;
   VideoPlayerWidget* m_rightPlayer;
+  MatchPreviewPlayer* m_previewPlayer;
   std::array<MatchEditorItemWidget*, 2> m_items;
   struct
   {
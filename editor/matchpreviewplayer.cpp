@@ -0,0 +1,287 @@
+#include "matchpreviewplayer.h"
+
+#include "videoplayerwidget.h"
+
+#include "mediaobject.h"
+#include "timestretch.h"
+
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioOutput>
+#include <QAudioSink>
+#include <QMediaDevices>
+#include <QMediaPlayer>
+
+#include <QIODevice>
+
+#include <QDebug>
+
+#include <algorithm>
+
+// Streams the output of a TimeStretcher, producing it as it is read.
+class StretchedAudioDevice : public QIODevice
+{
+public:
+  StretchedAudioDevice(std::shared_ptr<TimeStretcher> stretcher,
+                       int channelCount,
+                       size_t startSample,
+                       QObject* parent = nullptr)
+      : QIODevice(parent)
+      , m_stretcher(std::move(stretcher))
+      , m_channelCount(channelCount)
+      , m_nextSample(std::min(startSample, m_stretcher->outputSize()))
+  {}
+
+  bool isSequential() const override { return true; }
+
+  bool atEnd() const override { return m_nextSample >= m_stretcher->outputSize(); }
+
+  qint64 bytesAvailable() const override
+  {
+    const qint64 n = m_stretcher->outputSize() - m_nextSample;
+    return n * m_channelCount * qint64(sizeof(int16_t)) + QIODevice::bytesAvailable();
+  }
+
+protected:
+  qint64 readData(char* data, qint64 maxlen) override
+  {
+    const qint64 frame_size = m_channelCount * qint64(sizeof(int16_t));
+    const size_t n = std::min<size_t>(maxlen / frame_size, m_stretcher->outputSize() - m_nextSample);
+
+    m_stretcher->produce(m_nextSample + n);
+
+    auto* out = reinterpret_cast<int16_t*>(data);
+    const int16_t* in = m_stretcher->output() + m_nextSample;
+    for (size_t i(0); i < n; ++i)
+    {
+      std::fill_n(out + i * m_channelCount, m_channelCount, in[i]);
+    }
+
+    m_nextSample += n;
+    return n * frame_size;
+  }
+
+  qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+  std::shared_ptr<TimeStretcher> m_stretcher;
+  int m_channelCount;
+  size_t m_nextSample;
+};
+
+MatchPreviewPlayer::MatchPreviewPlayer(VideoPlayerWidget& videoPlayer, QObject* parent)
+    : QObject(parent)
+    , m_videoPlayer(videoPlayer)
+{
+  m_cache.setMaxCost(128 * 1024); // in kilobytes
+
+  connect(m_videoPlayer.player(),
+          &QMediaPlayer::positionChanged,
+          this,
+          &MatchPreviewPlayer::onVideoPositionChanged);
+  connect(m_videoPlayer.player(),
+          &QMediaPlayer::playbackStateChanged,
+          this,
+          &MatchPreviewPlayer::onVideoPlaybackStateChanged);
+}
+
+MatchPreviewPlayer::~MatchPreviewPlayer()
+{
+  stop();
+}
+
+bool MatchPreviewPlayer::isPlaying() const
+{
+  return m_playing;
+}
+
+bool MatchPreviewPlayer::play(const VideoMatch& match, const MediaObject& audioSource)
+{
+  stop();
+
+  if (!audioSource.audioInfo() || match.a.duration() <= 0 || match.b.duration() <= 0)
+  {
+    return false;
+  }
+
+  const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+  if (device.isNull())
+  {
+    qDebug() << "no audio output device";
+    return false;
+  }
+
+  const double ratio = match.b.duration() / double(match.a.duration());
+
+  // we use the sample rate of the source if the device supports it.
+  QAudioFormat format;
+  format.setSampleFormat(QAudioFormat::Int16);
+  format.setChannelCount(1);
+  format.setSampleRate(m_wav.file.fileName() == audioSource.audioInfo()->filePath
+                           ? m_wav.info.sampleRate
+                           : readWavSampleRate(audioSource.audioInfo()->filePath));
+
+  if (!device.isFormatSupported(format))
+  {
+    format.setChannelCount(device.preferredFormat().channelCount());
+    format.setSampleRate(device.preferredFormat().sampleRate());
+  }
+
+  m_audio = getStretchedAudio(audioSource.audioInfo()->filePath,
+                              match.b,
+                              ratio,
+                              format.sampleRate());
+
+  if (!m_audio)
+  {
+    return false;
+  }
+
+  m_match = match;
+  m_channelCount = format.channelCount();
+  m_audioSink = new QAudioSink(device, format, this);
+
+  if (QAudioOutput* output = m_videoPlayer.player()->audioOutput())
+  {
+    m_videoWasMuted = output->isMuted();
+    output->setMuted(true);
+  }
+
+  m_playing = true;
+  m_waitingForVideo = true;
+
+  // the audio is started once the video has actually reached the start of the match.
+  m_videoPlayer.seek(match.a.start());
+  m_videoPlayer.play();
+
+  Q_EMIT playingChanged();
+
+  return true;
+}
+
+void MatchPreviewPlayer::stop()
+{
+  if (!m_playing)
+  {
+    return;
+  }
+
+  m_playing = false;
+  m_waitingForVideo = false;
+
+  m_audioSink->stop();
+  m_audioSink->deleteLater();
+  m_audioSink = nullptr;
+
+  if (m_audioDevice)
+  {
+    m_audioDevice->deleteLater();
+    m_audioDevice = nullptr;
+  }
+
+  m_audio.reset();
+
+  m_videoPlayer.pause();
+
+  if (QAudioOutput* output = m_videoPlayer.player()->audioOutput())
+  {
+    output->setMuted(m_videoWasMuted);
+  }
+
+  Q_EMIT playingChanged();
+}
+
+void MatchPreviewPlayer::onVideoPositionChanged(qint64 pos)
+{
+  if (!m_playing)
+  {
+    return;
+  }
+
+  // the player may report its position before the seek, we allow a
+  // one-frame-ish tolerance.
+  constexpr int64_t tolerance = 50;
+
+  if (m_waitingForVideo)
+  {
+    if (pos + tolerance >= m_match.a.start() && pos < m_match.a.end())
+    {
+      startAudio(pos);
+    }
+
+    return;
+  }
+
+  if (pos >= m_match.a.end())
+  {
+    stop();
+  }
+}
+
+void MatchPreviewPlayer::onVideoPlaybackStateChanged()
+{
+  if (m_playing && !m_waitingForVideo
+      && m_videoPlayer.player()->playbackState() != QMediaPlayer::PlayingState)
+  {
+    stop();
+  }
+}
+
+std::shared_ptr<TimeStretcher> MatchPreviewPlayer::getStretchedAudio(const QString& wavFilePath,
+                                                                     const TimeSegment& range,
+                                                                     double ratio,
+                                                                     int outputSampleRate)
+{
+  const QString key = QString("%1-%2@%3:%4")
+                          .arg(QString::number(range.start()),
+                               QString::number(range.end()),
+                               QString::number(ratio, 'g', 12),
+                               QString::number(outputSampleRate));
+
+  if (std::shared_ptr<TimeStretcher>* cached = m_cache.object(key))
+  {
+    return *cached;
+  }
+
+  if (m_wav.file.fileName() != wavFilePath || !m_wav.file.isOpen())
+  {
+    m_wav.file.close();
+    m_wav.file.setFileName(wavFilePath);
+    if (!m_wav.file.open(QIODevice::ReadOnly))
+    {
+      qDebug() << "could not open" << wavFilePath;
+      return nullptr;
+    }
+
+    m_wav.info = readWavInfo(m_wav.file);
+  }
+
+  const WavInfo& info = m_wav.info;
+  if (info.sampleRate == 0)
+  {
+    return nullptr;
+  }
+
+  const int64_t first = (range.start() * info.sampleRate) / 1000;
+  const int64_t count = (range.duration() * info.sampleRate) / 1000;
+  std::vector<int16_t> samples = readWavSamples(m_wav.file, info, first, count);
+  samples = resample(samples, info.sampleRate, outputSampleRate);
+
+  auto stretcher = std::make_shared<TimeStretcher>(std::move(samples), outputSampleRate, ratio);
+  const int cost = 1 + int(stretcher->memoryUsage() / 1024);
+  m_cache.insert(key, new std::shared_ptr<TimeStretcher>(stretcher), cost);
+
+  return stretcher;
+}
+
+void MatchPreviewPlayer::startAudio(int64_t videoPos)
+{
+  m_waitingForVideo = false;
+
+  const int64_t offset = std::max<int64_t>(0, videoPos - m_match.a.start());
+  const size_t start_sample = (offset * m_audio->sampleRate()) / 1000;
+
+  m_audioDevice = new StretchedAudioDevice(m_audio, m_channelCount, start_sample, this);
+  m_audioDevice->open(QIODevice::ReadOnly);
+  m_audioSink->start(m_audioDevice);
+}
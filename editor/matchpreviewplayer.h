@@ -0,0 +1,73 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef MATCHPREVIEWPLAYER_H
+#define MATCHPREVIEWPLAYER_H
+
+#include "match.h"
+#include "wav.h"
+
+#include <QCache>
+#include <QFile>
+#include <QObject>
+
+#include <memory>
+
+class QAudioSink;
+
+class MediaObject;
+class TimeStretcher;
+class VideoPlayerWidget;
+
+class StretchedAudioDevice;
+
+// Plays the primary video of a match with the audio of the secondary
+// video, stretched to the duration of the match.
+// The audio is read from the wav extracted by MediaObject::extractAudioInfo()
+// and stretched in memory; stretched audio is cached by (range, ratio).
+class MatchPreviewPlayer : public QObject
+{
+  Q_OBJECT
+public:
+  explicit MatchPreviewPlayer(VideoPlayerWidget& videoPlayer, QObject* parent = nullptr);
+  ~MatchPreviewPlayer();
+
+  bool isPlaying() const;
+
+  bool play(const VideoMatch& match, const MediaObject& audioSource);
+  void stop();
+
+Q_SIGNALS:
+  void playingChanged();
+
+protected Q_SLOTS:
+  void onVideoPositionChanged(qint64 pos);
+  void onVideoPlaybackStateChanged();
+
+private:
+  std::shared_ptr<TimeStretcher> getStretchedAudio(const QString& wavFilePath,
+                                                   const TimeSegment& range,
+                                                   double ratio,
+                                                   int outputSampleRate);
+  void startAudio(int64_t videoPos);
+
+private:
+  VideoPlayerWidget& m_videoPlayer;
+  QCache<QString, std::shared_ptr<TimeStretcher>> m_cache;
+  struct
+  {
+    QFile file;
+    WavInfo info;
+  } m_wav;
+  VideoMatch m_match;
+  std::shared_ptr<TimeStretcher> m_audio;
+  QAudioSink* m_audioSink = nullptr;
+  StretchedAudioDevice* m_audioDevice = nullptr;
+  int m_channelCount = 1;
+  bool m_playing = false;
+  bool m_waitingForVideo = false;
+  bool m_videoWasMuted = false;
+};
+
+#endif // MATCHPREVIEWPLAYER_H
@@ -21,6 +21,7 @@
 #include "exporter.h"
 
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QProgressDialog>
 
@@ -865,6 +866,43 @@ void MainWindow::findMatchContaining(int64_t pos)
     }
   }
 
+  // the candidates kept by the match detector can be used without running it again
+  const std::vector<MatchCandidate> candidates = m_project->candidatesContaining(pos);
+  if (!candidates.empty())
+  {
+    QStringList items;
+    for (const MatchCandidate& c : candidates)
+    {
+      items << QString("%1 ~ %2 (score %3, min. distance %4)")
+                   .arg(c.match.a.toString(), c.match.b.toString())
+                   .arg(c.score, 0, 'f', 2)
+                   .arg(c.minDistance);
+    }
+    items << "Run the match detector...";
+
+    bool ok = false;
+    const QString item = QInputDialog::getItem(this,
+                                               "Find match",
+                                               "Matches found by the detector for this frame:",
+                                               items,
+                                               0,
+                                               false,
+                                               &ok);
+    if (!ok)
+    {
+      return;
+    }
+
+    const qsizetype index = items.indexOf(item);
+    if (index < qsizetype(candidates.size()))
+    {
+      MatchObject* obj = m_project->createMatch(candidates.at(index).match);
+      m_undoStack->push(new AddMatch(*obj, *m_project));
+      m_matchEditorWidget->setCurrentMatchObject(obj);
+      return;
+    }
+  }
+
   if (it != allmatches.end())
   {
     findMatchBefore(**it, pos);
@@ -0,0 +1,600 @@
+#include "alignment.h"
+
+#include "hashindex.h"
+#include "matchalgo.h"
+#include "matchtrace.h"
+#include "phash.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+
+namespace MatchAlgo {
+
+namespace {
+
+// Cell (i, j) of the alignment grid is reached once the first i frames of the
+// first video and the first j frames of the second video have been consumed.
+// The state tells how the last step was made.
+enum State : int {
+  Matched = 0,  // a[i - 1] is matched with b[j - 1]
+  SkippedA = 1, // a[i - 1] is skipped
+  SkippedB = 2, // b[j - 1] is skipped
+  AnyState = 3, // only used for the end of the whole alignment
+};
+
+constexpr int NumberOfStates = 3;
+
+// The cost of the cells that cannot be reached.
+// Costs are clamped to it, but as moves may pay, the cost of a cell that cannot be
+// reached may be slightly lower: anything above Infinity / 2 cannot be reached.
+constexpr int Infinity = std::numeric_limits<int>::max() / 4;
+
+inline int min3(int a, int b, int c)
+{
+  return std::min(a, std::min(b, c));
+}
+
+// All the costs are counted per frame consumed, so that a diagonal step
+// (which consumes one frame of each video) is worth two steps in a single video:
+// otherwise a staircase path would collect more rewards than the diagonal.
+struct Costs
+{
+  int threshold; // distance at which matching two frames neither costs nor pays
+  int stretch;   // matching a frame with a second frame of the other video
+  int gapOpen;   // starting to skip frames
+  int gapExtend; // skipping a frame
+};
+
+// The moves by which the Matched state is reached, in addition to a diagonal
+// move from each state.
+enum Move : int {
+  StretchA = NumberOfStates, // a[i - 1] is matched with b[j - 1] after a[i - 2]
+  StretchB,                  // b[j - 1] is matched with a[i - 1] after b[j - 2]
+};
+
+// The lowest cost among several moves, and the move with which it is reached.
+struct Choice
+{
+  int cost = Infinity;
+  int move = 0;
+
+  void consider(int c, int m)
+  {
+    if (c < cost)
+    {
+      cost = c;
+      move = m;
+    }
+  }
+};
+
+struct Step
+{
+  size_t i;
+  size_t j;
+  State state;
+};
+
+// The cells of row i that may be visited are those in [first[i], last[i]].
+// Both bounds must be non-decreasing.
+struct Band
+{
+  std::vector<size_t> first;
+  std::vector<size_t> last;
+};
+
+using CellCosts = std::array<int, NumberOfStates>;
+
+constexpr CellCosts InfiniteCosts = {Infinity, Infinity, Infinity};
+
+// The costs of a row of the alignment grid for the columns of a subproblem,
+// with a cell on each side that is never visited.
+// As the band is monotonic, the costs of the previous row that are read and are
+// not in the band are either never written, or in one of the cells just next to the band,
+// which are set to Infinity before computing a row.
+class RowCosts
+{
+public:
+  RowCosts(size_t first, size_t last)
+      : m_first(first)
+      , m_costs(last - first + 3, InfiniteCosts)
+  {}
+
+  CellCosts& operator[](size_t j) { return m_costs[j + 1 - m_first]; }
+  const CellCosts& operator[](size_t j) const { return m_costs[j + 1 - m_first]; }
+
+  // `j` may be one column before the first one
+  void clear(size_t j) { m_costs[j + 1 - m_first] = InfiniteCosts; }
+
+private:
+  size_t m_first;
+  std::vector<CellCosts> m_costs;
+};
+
+class Aligner
+{
+public:
+  Aligner(const quint64* a, size_t n, const quint64* b, size_t m, const Band& band, const Costs& costs)
+      : m_a(a)
+      , m_n(n)
+      , m_b(b)
+      , m_m(m)
+      , m_band(band)
+      , m_costs(costs)
+  {
+    assert(band.first.size() == n + 1 && band.last.size() == n + 1);
+    assert(band.first.front() == 0 && band.last.back() == m);
+    assert(std::is_sorted(band.first.begin(), band.first.end()));
+    assert(std::is_sorted(band.last.begin(), band.last.end()));
+  }
+
+  // Returns the steps of the best alignment, starting at (0, 0) in the Matched state.
+  std::vector<Step> run()
+  {
+    m_path.clear();
+    m_path.push_back(Step{0, 0, Matched});
+    solve(0, 0, Matched, m_n, m_m, AnyState);
+    return std::move(m_path);
+  }
+
+  quint64 cellsComputed() const { return m_cells; }
+
+private:
+  // the cost of matching a[i - 1] with b[j - 1], for one frame consumed
+  int pairCost(size_t i, size_t j) const
+  {
+    return phashDist(m_a[i - 1], m_b[j - 1]) - m_costs.threshold;
+  }
+
+  size_t rowBegin(size_t i, size_t j0) const { return std::max(m_band.first[i], j0); }
+  size_t rowEnd(size_t i, size_t j1) const { return std::min(m_band.last[i], j1); }
+
+  size_t blockCells(size_t i0, size_t j0, size_t i1, size_t j1) const
+  {
+    size_t result = 0;
+    for (size_t i(i0); i <= i1; ++i)
+    {
+      result += rowEnd(i, j1) + 1 - rowBegin(i, j0);
+    }
+    return result;
+  }
+
+  // Computes the costs of the best paths to row i from row i - 1 (`prev`).
+  // If `startState` is a valid state, the path starts in that state at (i, j0)
+  // and `prev` is ignored.
+  // If `trace` is not null, the moves by which each cell is reached are written
+  // to trace[j - rowBegin(i, j0)].
+  void forwardRow(const RowCosts& prev,
+                  size_t i,
+                  size_t j0,
+                  size_t j1,
+                  int startState,
+                  RowCosts& cur,
+                  quint8* trace = nullptr)
+  {
+    const Costs& c = m_costs;
+    const size_t begin = rowBegin(i, j0);
+    const size_t end = rowEnd(i, j1);
+    assert(begin <= end);
+    m_cells += end + 1 - begin;
+
+    cur.clear(begin - 1);
+
+    for (size_t j(begin); j <= end; ++j)
+    {
+      CellCosts& cell = cur[j];
+
+      if (j == j0 && startState != AnyState)
+      {
+        cell = InfiniteCosts;
+        cell[startState] = 0;
+        continue;
+      }
+
+      const CellCosts& diagonal = prev[j - 1];
+      const CellCosts& up = prev[j];
+      const CellCosts& left = cur[j - 1];
+
+      Choice matched;
+      Choice skipped_a;
+      Choice skipped_b;
+
+      if (i >= 1 && j >= 1)
+      {
+        const int pair = pairCost(i, j);
+        for (int s(0); s < NumberOfStates; ++s)
+        {
+          matched.consider(diagonal[s] + 2 * pair, s);
+        }
+        matched.consider(up[Matched] + pair + c.stretch, StretchA);
+        matched.consider(left[Matched] + pair + c.stretch, StretchB);
+      }
+
+      for (int s(0); s < NumberOfStates; ++s)
+      {
+        skipped_a.consider(up[s] + (s == SkippedA ? 0 : c.gapOpen) + c.gapExtend, s);
+        skipped_b.consider(left[s] + (s == SkippedB ? 0 : c.gapOpen) + c.gapExtend, s);
+      }
+
+      cell[Matched] = std::min(matched.cost, Infinity);
+      cell[SkippedA] = std::min(skipped_a.cost, Infinity);
+      cell[SkippedB] = std::min(skipped_b.cost, Infinity);
+
+      if (trace)
+      {
+        trace[j - begin] = quint8(matched.move | (skipped_a.move << 3) | (skipped_b.move << 5));
+      }
+    }
+  }
+
+  // Computes the costs of the best paths from row i to the end, given those
+  // from row i + 1 (`next`).
+  // If `endState` is valid, the path ends at (i, j1) in that state (in any state
+  // for AnyState) and `next` is ignored.
+  void backwardRow(const RowCosts& next, size_t i, size_t j0, size_t j1, int endState, RowCosts& cur)
+  {
+    const Costs& c = m_costs;
+    const size_t begin = rowBegin(i, j0);
+    const size_t end = rowEnd(i, j1);
+    assert(begin <= end);
+    m_cells += end + 1 - begin;
+
+    cur.clear(end + 1);
+
+    for (size_t j(end + 1); j-- > begin;)
+    {
+      CellCosts& cell = cur[j];
+
+      if (j == j1 && endState >= 0)
+      {
+        for (int s(0); s < NumberOfStates; ++s)
+        {
+          cell[s] = (endState == AnyState || endState == s) ? 0 : Infinity;
+        }
+        continue;
+      }
+
+      const CellCosts& down = next[j];
+      const CellCosts& right = cur[j + 1];
+
+      // there is no next row below the last one
+      const bool has_next = i < m_n;
+
+      int diagonal = Infinity;
+      int stretch = Infinity;
+      if (j < m_m)
+      {
+        if (has_next)
+        {
+          diagonal = next[j + 1][Matched] + 2 * pairCost(i + 1, j + 1);
+        }
+        if (i >= 1)
+        {
+          stretch = right[Matched] + pairCost(i, j + 1) + c.stretch;
+        }
+      }
+      if (j >= 1 && has_next)
+      {
+        stretch = std::min(stretch, down[Matched] + pairCost(i + 1, j) + c.stretch);
+      }
+
+      const int open_a = down[SkippedA] + c.gapOpen + c.gapExtend;
+      const int open_b = right[SkippedB] + c.gapOpen + c.gapExtend;
+
+      cell[Matched] = std::min(std::min(min3(diagonal, stretch, open_a), open_b), Infinity);
+      cell[SkippedA] = std::min(min3(diagonal, down[SkippedA] + c.gapExtend, open_b), Infinity);
+      cell[SkippedB] = std::min(min3(diagonal, open_a, right[SkippedB] + c.gapExtend), Infinity);
+    }
+  }
+
+  // Appends to m_path the steps of the best path from (i0, j0) in state s0
+  // to (i1, j1) in state s1, excluding the first one.
+  void solve(size_t i0, size_t j0, int s0, size_t i1, size_t j1, int s1)
+  {
+    // small enough to keep the moves of every cell and trace the path back
+    constexpr size_t max_block_cells = 1 << 22;
+
+    if (i1 - i0 <= 1 || blockCells(i0, j0, i1, j1) <= max_block_cells)
+    {
+      solveBlock(i0, j0, s0, i1, j1, s1);
+      return;
+    }
+
+    const size_t mid = (i0 + i1) / 2;
+
+    size_t best_j = 0;
+    int best_state = Matched;
+
+    {
+      RowCosts forward{j0, j1};
+      RowCosts backward{j0, j1};
+      RowCosts other{j0, j1};
+
+      forwardRow(other, i0, j0, j1, s0, forward);
+      for (size_t i(i0 + 1); i <= mid; ++i)
+      {
+        std::swap(forward, other);
+        forwardRow(other, i, j0, j1, AnyState, forward);
+      }
+
+      other = RowCosts(j0, j1);
+      backwardRow(other, i1, j0, j1, s1, backward);
+      for (size_t i(i1); i-- > mid;)
+      {
+        std::swap(backward, other);
+        backwardRow(other, i, j0, j1, -1, backward);
+      }
+
+      int best = Infinity;
+      for (size_t j(rowBegin(mid, j0)); j <= rowEnd(mid, j1); ++j)
+      {
+        for (int s(0); s < NumberOfStates; ++s)
+        {
+          const int total = forward[j][s] + backward[j][s];
+          if (total < best)
+          {
+            best = total;
+            best_j = j;
+            best_state = s;
+          }
+        }
+      }
+
+      assert(best < Infinity / 2);
+    }
+
+    solve(i0, j0, s0, mid, best_j, best_state);
+    solve(mid, best_j, best_state, i1, j1, s1);
+  }
+
+  void solveBlock(size_t i0, size_t j0, int s0, size_t i1, size_t j1, int s1)
+  {
+    std::vector<size_t> trace_offsets(i1 - i0 + 2, 0);
+    for (size_t i(i0); i <= i1; ++i)
+    {
+      trace_offsets[i - i0 + 1] = trace_offsets[i - i0] + rowEnd(i, j1) + 1 - rowBegin(i, j0);
+    }
+
+    std::vector<quint8> trace(trace_offsets.back());
+
+    RowCosts prev{j0, j1};
+    RowCosts cur{j0, j1};
+    forwardRow(prev, i0, j0, j1, s0, cur, trace.data());
+    for (size_t i(i0 + 1); i <= i1; ++i)
+    {
+      std::swap(prev, cur);
+      forwardRow(prev, i, j0, j1, AnyState, cur, trace.data() + trace_offsets[i - i0]);
+    }
+
+    size_t i = i1;
+    size_t j = j1;
+    int s = s1;
+
+    if (s == AnyState)
+    {
+      s = Matched;
+      for (int t(1); t < NumberOfStates; ++t)
+      {
+        if (cur[j][t] < cur[j][s])
+        {
+          s = t;
+        }
+      }
+    }
+
+    assert(cur[j][s] < Infinity / 2);
+
+    const size_t path_size = m_path.size();
+
+    while (!(i == i0 && j == j0 && s == s0))
+    {
+      m_path.push_back(Step{i, j, State(s)});
+
+      const quint8 moves = trace[trace_offsets[i - i0] + j - rowBegin(i, j0)];
+
+      if (s == Matched)
+      {
+        const int move = moves & 7;
+        i -= (move != StretchB);
+        j -= (move != StretchA);
+        s = move < NumberOfStates ? move : Matched;
+      }
+      else if (s == SkippedA)
+      {
+        i -= 1;
+        s = (moves >> 3) & 3;
+      }
+      else
+      {
+        j -= 1;
+        s = (moves >> 5) & 3;
+      }
+
+      assert(i >= i0 && j >= j0);
+    }
+
+    std::reverse(m_path.begin() + path_size, m_path.end());
+  }
+
+private:
+  const quint64* m_a;
+  size_t m_n;
+  const quint64* m_b;
+  size_t m_m;
+  const Band& m_band;
+  Costs m_costs;
+  std::vector<Step> m_path;
+  quint64 m_cells = 0;
+};
+
+// Returns the longest chain of pairs of frames (i, j) with nearly identical hashes
+// that is increasing in both videos. Frames are relative to the spans.
+std::vector<std::pair<size_t, size_t>> find_anchors(const FrameSpan& a,
+                                                    const FrameSpan& b,
+                                                    const HashIndex& index,
+                                                    int radius)
+{
+  // only some frames of `a` are looked up, a scene gets several anchors anyway
+  constexpr size_t step = 4;
+  constexpr size_t max_hits = 32;
+
+  // the candidates of a frame of `a` are sorted by decreasing j, so that
+  // at most one of them ends up in the chain
+  std::vector<std::pair<size_t, size_t>> candidates = find_similar_frames(index, a, b, radius, step, max_hits);
+  std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second > rhs.second);
+  });
+
+  // longest strictly increasing subsequence of the j's, in O(k log k)
+  constexpr size_t npos = std::numeric_limits<size_t>::max();
+  std::vector<size_t> tails;
+  std::vector<size_t> previous(candidates.size(), npos);
+  for (size_t c(0); c < candidates.size(); ++c)
+  {
+    auto it = std::lower_bound(tails.begin(), tails.end(), candidates[c].second, [&](size_t t, size_t j) {
+      return candidates[t].second < j;
+    });
+    previous[c] = it == tails.begin() ? npos : *std::prev(it);
+    if (it == tails.end())
+    {
+      tails.push_back(c);
+    }
+    else
+    {
+      *it = c;
+    }
+  }
+
+  std::vector<std::pair<size_t, size_t>> result;
+  for (size_t c = tails.empty() ? npos : tails.back(); c != npos; c = previous[c])
+  {
+    result.push_back(candidates[c]);
+  }
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+// Returns the band covering, for each pair of consecutive anchors, the rectangle
+// of the cells between them, widened by `radius`.
+// Between distant anchors (e.g. around a scene that is only in one of the videos)
+// the band is therefore as wide as needed.
+Band anchor_band(const std::vector<std::pair<size_t, size_t>>& anchors, size_t n, size_t m, size_t radius)
+{
+  Band band;
+  band.first.assign(n + 1, m);
+  band.last.assign(n + 1, 0);
+
+  // matching frames (i, j) is reaching cell (i + 1, j + 1)
+  std::vector<std::pair<size_t, size_t>> points;
+  points.reserve(anchors.size() + 2);
+  points.emplace_back(0, 0);
+  for (const auto& [i, j] : anchors)
+  {
+    points.emplace_back(i + 1, j + 1);
+  }
+  points.emplace_back(n, m);
+
+  for (size_t k(1); k < points.size(); ++k)
+  {
+    const auto [i0, j0] = points[k - 1];
+    const auto [i1, j1] = points[k];
+    const size_t first_col = j0 > radius ? j0 - radius : 0;
+    const size_t last_col = std::min(m, j1 + radius);
+
+    for (size_t r(i0 > radius ? i0 - radius : 0); r <= std::min(n, i1 + radius); ++r)
+    {
+      band.first[r] = std::min(band.first[r], first_col);
+      band.last[r] = std::max(band.last[r], last_col);
+    }
+  }
+
+  return band;
+}
+
+} // namespace
+
+std::vector<std::pair<FrameSpan, FrameSpan>> align_frames(const FrameSpan& a,
+                                                          const FrameSpan& b,
+                                                          const HashIndex& index,
+                                                          const Parameters& params)
+{
+  // frames around the chain of anchors
+  constexpr size_t band_radius = 8;
+  // a match is split where more than this number of consecutive frames do not match
+  constexpr size_t max_unmatched_frames = 2;
+  constexpr size_t min_match_length = 4;
+
+  std::vector<std::pair<FrameSpan, FrameSpan>> result;
+
+  if (a.size() == 0 || b.size() == 0)
+  {
+    return result;
+  }
+
+  Costs costs;
+  costs.threshold = params.frameUnmatchThreshold;
+  costs.stretch = 2;
+  costs.gapOpen = 4 * params.frameUnmatchThreshold;
+  costs.gapExtend = 0;
+
+  const std::vector<std::pair<size_t, size_t>> anchors = find_anchors(a, b, index, params.seedRadius);
+  const Band band = anchor_band(anchors, a.size(), b.size(), band_radius);
+
+  Aligner aligner{a.hashes(), a.size(), b.hashes(), b.size(), band, costs};
+  const std::vector<Step> path = aligner.run();
+
+  MATCH_TRACE(Summary, "alignment")
+      .field("a", a)
+      .field("b", b)
+      .field("anchors", anchors.size())
+      .field("cells", aligner.cellsComputed());
+
+  // the runs of matched frames, split where the frames do not actually match
+  auto is_match = [&](const Step& step) {
+    return phashDist(a.hash(step.i - 1), b.hash(step.j - 1)) < params.frameUnmatchThreshold;
+  };
+
+  auto emit = [&](const Step& first, const Step& last) {
+    const size_t count_a = last.i - first.i + 1;
+    const size_t count_b = last.j - first.j + 1;
+    if (std::min(count_a, count_b) >= min_match_length)
+    {
+      result.emplace_back(a.subspan(first.i - 1, count_a), b.subspan(first.j - 1, count_b));
+    }
+  };
+
+  const Step* run_first = nullptr;
+  const Step* run_last = nullptr;
+  size_t unmatched = 0;
+
+  for (const Step& step : path)
+  {
+    const bool matched = step.state == Matched && step.i > 0 && step.j > 0 && is_match(step);
+
+    if (matched)
+    {
+      if (!run_first)
+      {
+        run_first = &step;
+      }
+      run_last = &step;
+      unmatched = 0;
+    }
+    else if (run_first && (step.state != Matched || ++unmatched > max_unmatched_frames))
+    {
+      emit(*run_first, *run_last);
+      run_first = nullptr;
+    }
+  }
+
+  if (run_first)
+  {
+    emit(*run_first, *run_last);
+  }
+
+  return result;
+}
+
+} // namespace MatchAlgo
@@ -0,0 +1,40 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef ALIGNMENT_H
+#define ALIGNMENT_H
+
+#include <utility>
+#include <vector>
+
+namespace MatchAlgo {
+
+class FrameSpan;
+class HashIndex;
+struct Parameters;
+
+// Aligns the frames of `a` with the frames of `b` as a whole, instead of
+// matching the scenes one after the other.
+// Each frame of a video is either matched with a frame of the other video, or skipped.
+// Matching two frames pays (or costs) the difference between their distance and
+// Parameters::frameUnmatchThreshold, skipping frames costs a fixed penalty per gap,
+// and the alignment with the lowest total cost is computed with dynamic programming
+// (dynamic time warping with affine gaps).
+//
+// The alignment is only computed within a band around a coarse alignment, made of
+// the longest chain of "anchors": frames of `a` whose hash is nearly identical
+// (within Parameters::seedRadius) to that of a frame of `b`, found with `index`
+// (which must be built over the video of `b`).
+// The alignment is computed in linear memory with Hirschberg's divide and conquer,
+// in a time about proportional to the size of the videos times the width of the band.
+//
+// Returns the matching areas, in increasing order in both videos.
+std::vector<std::pair<FrameSpan, FrameSpan>> align_frames(const FrameSpan& a,
+                                                          const FrameSpan& b,
+                                                          const HashIndex& index,
+                                                          const Parameters& params);
+
+} // namespace MatchAlgo
+
+#endif // ALIGNMENT_H
@@ -4,6 +4,7 @@
 #include "cache.h"
 #include "exerun.h"
 #include "mediaobject.h"
+#include "profiler.h"
 #include "vfparser.h"
 
 #include <QFile>
@@ -83,18 +84,25 @@ void save_blackdetect_to_disk(const std::vector<TimeSegment>& silences,
 BlackdetectThread::BlackdetectThread(const MediaObject& media)
     : m_filePath(media.filePath())
     , m_fileName(media.fileName())
-    , m_nbFrames(media.numberOfPackets())
+    , m_cacheKey(media.cacheKey())
 {
   CreateCacheDir();
 }
 
 BlackdetectThread::~BlackdetectThread() {}
 
-double BlackdetectThread::duration() const
+double BlackdetectThread::duration()
 {
   return 0.4;
 }
 
+QString BlackdetectThread::cacheFilePath(const QString& cacheKey)
+{
+  return GetCacheFilePath(cacheKey,
+                          "blackdetect",
+                          QString("blackdetect=d=%1:pix_th=0.05").arg(QString::number(duration())));
+}
+
 std::vector<TimeSegment>& BlackdetectThread::blackframes()
 {
   assert(isFinished());
@@ -103,12 +111,13 @@ std::vector<TimeSegment>& BlackdetectThread::blackframes()
 
 void BlackdetectThread::run()
 {
+  ProfileScope profile_scope{"media", "BlackdetectThread::run", m_fileName};
+
   constexpr const char* duration_threshold = "0.4";
 
   m_blackframes.clear();
 
-  const QString cache_filepath = GetCacheDir() + "/" + m_fileName + "."
-                                 + QString::number(m_nbFrames) + ".blackdetect";
+  const QString cache_filepath = cacheFilePath(m_cacheKey);
 
   if (QFile::exists(cache_filepath))
   {
@@ -10,6 +10,12 @@
 
 class MediaObject;
 
+// Reads the cache file written by the thread; returns false if it was written
+// with another minimum duration.
+bool read_blackdetect_from_disk(std::vector<TimeSegment>& blackframes,
+                                double duration,
+                                const QString& cacheFilePath);
+
 class BlackdetectThread : public QThread
 {
   Q_OBJECT
@@ -17,15 +23,19 @@ public:
   explicit BlackdetectThread(const MediaObject& media);
   ~BlackdetectThread();
 
-  double duration() const;
+  // minimum duration of the detected segments, in seconds
+  static double duration();
   std::vector<TimeSegment>& blackframes();
 
+  // path of the cache file of the media with the given cache key
+  static QString cacheFilePath(const QString& cacheKey);
+
 protected:
   void run() final;
 
 private:
   QString m_filePath;
   QString m_fileName;
-  int m_nbFrames;
+  QString m_cacheKey;
   std::vector<TimeSegment> m_blackframes;
 };
@@ -1,10 +1,124 @@
 
 #include "cache.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QStandardPaths>
 
+#include <algorithm>
+
+namespace {
+
+constexpr qint64 fingerprint_block_size = 64 * 1024;
+constexpr int fingerprint_blocks = 4;
+
+struct IndexEntry
+{
+  qint64 size = 0;
+  qint64 lastModified = 0;
+  QString fingerprint;
+};
+
+// Fingerprints of the media files, by absolute path.
+// The index file has one line per fingerprint computed, the last one of a path wins.
+class FingerprintIndex
+{
+public:
+  const IndexEntry* find(const QString& path)
+  {
+    load();
+    auto it = m_entries.constFind(path);
+    return it != m_entries.constEnd() ? &it.value() : nullptr;
+  }
+
+  void insert(const QString& path, const IndexEntry& entry)
+  {
+    load();
+    m_entries.insert(path, entry);
+
+    CreateCacheDir();
+    QFile file{filePath()};
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+      const QString line = QString("%1\t%2\t%3\t%4\n")
+                               .arg(entry.fingerprint,
+                                    QString::number(entry.size),
+                                    QString::number(entry.lastModified),
+                                    path);
+      file.write(line.toUtf8());
+    }
+  }
+
+  QMutex& mutex() { return m_mutex; }
+
+private:
+  static QString filePath() { return GetCacheDir() + "/media.index"; }
+
+  void load()
+  {
+    if (m_loaded)
+    {
+      return;
+    }
+
+    m_loaded = true;
+
+    QFile file{filePath()};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+      return;
+    }
+
+    while (!file.atEnd())
+    {
+      const QStringList parts = QString::fromUtf8(file.readLine()).remove('\n').split('\t');
+      if (parts.size() == 4)
+      {
+        m_entries.insert(parts.at(3), IndexEntry{parts.at(1).toLongLong(), parts.at(2).toLongLong(), parts.at(0)});
+      }
+    }
+  }
+
+private:
+  QMutex m_mutex;
+  bool m_loaded = false;
+  QHash<QString, IndexEntry> m_entries;
+};
+
+FingerprintIndex& fingerprint_index()
+{
+  static FingerprintIndex index;
+  return index;
+}
+
+QString compute_fingerprint(QFile& file)
+{
+  const qint64 size = file.size();
+
+  QCryptographicHash hash{QCryptographicHash::Sha1};
+  hash.addData(QByteArray::number(size));
+
+  // blocks evenly spread over the file, including its start and its end
+  for (int i(0); i < fingerprint_blocks; ++i)
+  {
+    const qint64 max_offset = std::max<qint64>(size - fingerprint_block_size, 0);
+    if (!file.seek(max_offset * i / (fingerprint_blocks - 1)))
+    {
+      return QString();
+    }
+    hash.addData(file.read(fingerprint_block_size));
+  }
+
+  return QString::fromLatin1(hash.result().toHex().left(32));
+}
+
+} // namespace
+
 QString GetCacheDir()
 {
   return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -18,3 +132,55 @@ void CreateCacheDir()
     QDir().mkpath(path);
   }
 }
+
+QString GetMediaFingerprint(const QString& filePath)
+{
+  const QFileInfo info{filePath};
+  const QString path = info.absoluteFilePath();
+  const qint64 last_modified = info.lastModified().toMSecsSinceEpoch();
+
+  FingerprintIndex& index = fingerprint_index();
+  QMutexLocker lock{&index.mutex()};
+
+  const IndexEntry* entry = index.find(path);
+  if (entry && entry->size == info.size() && entry->lastModified == last_modified)
+  {
+    return entry->fingerprint;
+  }
+
+  QFile file{filePath};
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return QString();
+  }
+
+  const QString fingerprint = compute_fingerprint(file);
+  if (!fingerprint.isEmpty())
+  {
+    index.insert(path, IndexEntry{info.size(), last_modified, fingerprint});
+  }
+
+  return fingerprint;
+}
+
+QString FindMediaFingerprint(const QString& filePath)
+{
+  FingerprintIndex& index = fingerprint_index();
+  QMutexLocker lock{&index.mutex()};
+
+  const IndexEntry* entry = index.find(QFileInfo(filePath).absoluteFilePath());
+  return entry ? entry->fingerprint : QString();
+}
+
+QString GetCacheFilePath(const QString& fingerprint, const QString& analysis, const QString& parameters)
+{
+  QString name = fingerprint + "." + analysis;
+
+  if (!parameters.isEmpty())
+  {
+    const QByteArray hash = QCryptographicHash::hash(parameters.toUtf8(), QCryptographicHash::Sha1);
+    name += "." + QString::fromLatin1(hash.toHex().left(8));
+  }
+
+  return GetCacheDir() + "/" + name;
+}
@@ -8,3 +8,20 @@
 
 void CreateCacheDir();
 QString GetCacheDir();
+
+// Returns a fingerprint of the content of a media file: a hash of its size and
+// of a few blocks sampled across the file, so that renaming or moving the file
+// keeps its cached analyses, and that two files with the same name do not share them.
+// The fingerprints are kept in an index of the cache, by path, size and modification
+// time, so that the file is only read the first time.
+// Returns an empty string if the file cannot be read.
+QString GetMediaFingerprint(const QString& filePath);
+
+// Returns the last fingerprint computed for the file at this path,
+// without reading the file (which may not exist anymore), or an empty string.
+QString FindMediaFingerprint(const QString& filePath);
+
+// Returns the path of the cache file holding the result of an analysis of a media,
+// run with the given parameters (e.g. the ffmpeg filter used).
+// The file may not exist yet.
+QString GetCacheFilePath(const QString& fingerprint, const QString& analysis, const QString& parameters = QString());
@@ -1,5 +1,8 @@
 #include "exerun.h"
 
+#include "processstats.h"
+#include "profiler.h"
+
 #include <QCoreApplication>
 #include <QEventLoop>
 #include <QThread>
@@ -13,6 +16,8 @@ QProcess* run(const QString& name, const QStringList& args)
   auto* process = new QProcess(parent);
   process->setProgram(name);
   process->setArguments(args);
+  profileProcess(*process);
+  watchProcessCpuTime(*process);
   process->start();
   return process;
 }
@@ -2,14 +2,21 @@
 
 #include "exerun.h"
 #include "mediaobject.h"
+#include "processpool.h"
+#include "processstats.h"
+#include "profiler.h"
 #include "project.h"
 
+#include <QElapsedTimer>
 #include <QEventLoop>
 
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QTemporaryDir>
 
+#include <algorithm>
+
 std::vector<OutputSegment> dubCompute(const std::vector<VideoMatch>& matches, Duration mediaDuration)
 {
   std::vector<OutputSegment> result;
@@ -31,7 +38,8 @@ std::vector<OutputSegment> dubCompute(const std::vector<VideoMatch>& matches, Du
       curtime = m.a.start();
     }
 
-    if (m.a.duration() == 0)
+    // the original audio is kept where there is nothing to dub with
+    if (m.a.duration() == 0 || m.b.duration() == 0)
     {
       continue;
     }
@@ -71,6 +79,53 @@ std::vector<OutputSegment> dubCompute(const DubbingProject& project, const Media
   return dubCompute(project, Duration(video.duration() * 1000));
 }
 
+// Returns the sorted list of time ranges of source `sourceId` that are used by
+// the output segments.
+// Ranges that are less than `maxGap` msecs apart are merged together.
+std::vector<TimeSegment> computeSourceRanges(const std::vector<OutputSegment>& segments,
+                                             int sourceId,
+                                             int64_t maxGap)
+{
+  std::vector<TimeSegment> result;
+
+  for (const OutputSegment& seg : segments)
+  {
+    if (seg.source_id == sourceId && seg.source_segment.duration() > 0)
+    {
+      result.push_back(seg.source_segment);
+    }
+  }
+
+  std::sort(result.begin(), result.end(), [](const TimeSegment& a, const TimeSegment& b) {
+    return a.start() < b.start();
+  });
+
+  auto it = result.begin();
+  for (auto next = result.begin(); next != result.end(); ++next)
+  {
+    if (next == it)
+    {
+      continue;
+    }
+
+    if (next->start() - it->end() <= maxGap)
+    {
+      it->setEnd(std::max(it->end(), next->end()));
+    }
+    else
+    {
+      *(++it) = *next;
+    }
+  }
+
+  if (!result.empty())
+  {
+    result.erase(std::next(it), result.end());
+  }
+
+  return result;
+}
+
 std::optional<double> extractPeakLevel(const QString& output)
 {
   const QString searchstring = "Peak level dB: ";
@@ -120,12 +175,60 @@ enum class ExportStep {
   Done = 7,
 };
 
+static QString step_description(ExportStep step)
+{
+  switch (step)
+  {
+  case ExportStep::ExtractAudioTracks:
+    return "Extracting audio tracks";
+  case ExportStep::MeasureGain:
+    return "Measuring audio gain";
+  case ExportStep::ExtractAudioSegments:
+    return "Extracting audio segments";
+  case ExportStep::PostProcessAudioSegments:
+    return "Post-processing audio segments";
+  case ExportStep::ConcatenateAudioSegments:
+    return "Concatenating audio segments";
+  case ExportStep::MergeFiles:
+    return "Merging files";
+  case ExportStep::Done:
+    return "Done";
+  default:
+    break;
+  }
+
+  return QString();
+}
+
+// Returns the file written by an ffmpeg or mkvmerge command line,
+// or an empty string if the output is discarded.
+static QString output_file_path(const QString& program, const QStringList& args)
+{
+  if (program == "mkvmerge")
+  {
+    const int index = args.indexOf("-o");
+    return index != -1 && index + 1 < args.size() ? args.at(index + 1) : QString();
+  }
+
+  if (args.isEmpty() || args.last() == "-")
+  {
+    return QString();
+  }
+
+  return args.last();
+}
+
+// Source ranges that are closer than this are decoded in a single pass;
+// seeking into the input costs more than decoding a few extra seconds.
+constexpr int64_t MaxSourceRangeGap = 5000; // msecs
+
 struct DubExporter::Data
 {
   QTemporaryDir tempDir;
   ExportStep currentStep = ExportStep::ExtractAudioTracks;
   bool waiting = false;
 
+  std::vector<TimeSegment> sourceRanges[2];
   int numberOfAudioTracksExtracted = 0;
 
   int trackSampleRates[2] = {0};
@@ -140,6 +243,16 @@ struct DubExporter::Data
 
   QFile listtxt;
   QProcess* mkvmerge = nullptr;
+
+  QElapsedTimer timer;
+  int64_t stepStartTime = 0;
+  // the processes of the export are in the group of the exporter
+  ChildrenCpuTimer cpuTimer;
+  ChildrenCpuTimer stepCpuTimer;
+
+  // the steps of each export are drawn on their own line of the profile
+  uint64_t profileTrack = 0;
+  int64_t stepProfileStartTime = 0;
 };
 
 DubExporter::DubExporter(const DubbingProject& project, const MediaObject& video, QObject* parent)
@@ -166,6 +279,23 @@ void DubExporter::setOutputFilePath(const QString& path)
   m_outputFilePath = path;
 }
 
+ProcessPool* DubExporter::processPool() const
+{
+  return m_processPool;
+}
+
+void DubExporter::setProcessPool(ProcessPool* pool)
+{
+  Q_ASSERT(!isRunning());
+  m_processPool = pool;
+}
+
+QString DubExporter::partialOutputFilePath() const
+{
+  const QFileInfo info{outputFilePath()};
+  return info.dir().filePath(info.completeBaseName() + ".part." + info.suffix());
+}
+
 void DubExporter::run()
 {
   if (isRunning())
@@ -174,6 +304,8 @@ void DubExporter::run()
     return;
   }
 
+  m_succeeded = false;
+
   d = std::make_unique<Data>();
   if (!d->tempDir.isValid())
   {
@@ -184,6 +316,42 @@ void DubExporter::run()
 
   d->osegs = dubCompute(project(), m_video);
 
+  for (int source_id : {0, 1})
+  {
+    d->sourceRanges[source_id] = computeSourceRanges(d->osegs, source_id, MaxSourceRangeGap);
+  }
+
+  m_report = ExportReport();
+  m_report.projectTitle = project().projectTitle();
+  m_report.outputFilePath = outputFilePath();
+  m_report.startTime = QDateTime::currentDateTime();
+
+  for (int i = static_cast<int>(ExportStep::ExtractAudioTracks); i < static_cast<int>(ExportStep::Done); ++i)
+  {
+    ExportStepStats stats;
+    stats.name = step_description(static_cast<ExportStep>(i));
+    m_report.steps.push_back(stats);
+  }
+
+  for (const OutputSegment& seg : d->osegs)
+  {
+    ExportSegmentStats stats;
+    stats.sourceId = seg.source_id;
+    stats.outputSegment = seg.output_segment;
+    stats.sourceSegment = seg.source_segment;
+    m_report.segments.push_back(stats);
+  }
+
+  d->timer.start();
+  d->cpuTimer = ChildrenCpuTimer(this);
+  d->stepCpuTimer = ChildrenCpuTimer(this);
+
+  if (isProfiling())
+  {
+    d->profileTrack = newProfileTrack();
+    d->stepProfileStartTime = profilingClock();
+  }
+
   Q_EMIT statusChanged();
 
   step();
@@ -194,6 +362,11 @@ bool DubExporter::isRunning() const
   return d != nullptr;
 }
 
+bool DubExporter::succeeded() const
+{
+  return m_succeeded;
+}
+
 QString DubExporter::status() const
 {
   if (!d)
@@ -201,27 +374,7 @@ QString DubExporter::status() const
     return QString();
   }
 
-  switch (d->currentStep)
-  {
-  case ExportStep::ExtractAudioTracks:
-    return "Extracting audio tracks";
-  case ExportStep::MeasureGain:
-    return "Measuring audio gain";
-  case ExportStep::ExtractAudioSegments:
-    return "Extracting audio segments";
-  case ExportStep::PostProcessAudioSegments:
-    return "Post-processing audio segments";
-  case ExportStep::ConcatenateAudioSegments:
-    return "Concatenating audio segments";
-  case ExportStep::MergeFiles:
-    return "Merging files";
-  case ExportStep::Done:
-    return "Done";
-  default:
-    break;
-  }
-
-  return QString();
+  return step_description(d->currentStep);
 }
 
 float DubExporter::progress() const
@@ -240,16 +393,21 @@ float DubExporter::progress() const
 
   float p = stepvalue * static_cast<int>(d->currentStep);
 
+  // a step with nothing to do is skipped, but may still be reported
+  auto step_progress = [stepvalue](size_t done, size_t total) {
+    return total > 0 ? done * (stepvalue / total) : 0.f;
+  };
+
   switch (d->currentStep)
   {
   case ExportStep::ExtractAudioTracks:
-    p += 0.5 * stepvalue * d->numberOfAudioTracksExtracted;
+    p += step_progress(d->numberOfAudioTracksExtracted, numberOfSourceRanges());
     break;
   case ExportStep::ExtractAudioSegments:
-    p += d->numberOfAudioSegmentsExtracted * (stepvalue / d->osegs.size());
+    p += step_progress(d->numberOfAudioSegmentsExtracted, d->osegs.size());
     break;
   case ExportStep::PostProcessAudioSegments:
-    p += d->numberOfAudioSegmentsPostProcessed * (stepvalue / d->osegs.size());
+    p += step_progress(d->numberOfAudioSegmentsPostProcessed, d->osegs.size());
     break;
   default:
     break;
@@ -270,6 +428,19 @@ void DubExporter::waitForFinished()
   loop.exec();
 }
 
+// Returns the report of the last export.
+// It is filled while the export runs and complete once finished() has been emitted.
+const ExportReport& DubExporter::report() const
+{
+  return m_report;
+}
+
+QString DubExporter::reportFilePath() const
+{
+  const QFileInfo info{outputFilePath()};
+  return info.dir().filePath(info.completeBaseName() + ".report.json");
+}
+
 void DubExporter::step()
 {
   Q_ASSERT(d);
@@ -279,10 +450,10 @@ void DubExporter::step()
     return;
   }
 
+  ProfileScope profile_scope{"export", "DubExporter::step", step_description(d->currentStep)};
+
   QTemporaryDir& tempDir = d->tempDir;
 
-  const QString source_audio1_path = tempDir.filePath("src1.wav");
-  const QString source_audio2_path = tempDir.filePath("src2.wav");
   const QString output_audio_path = tempDir.filePath("concat.mka");
 
   switch (d->currentStep)
@@ -290,7 +461,7 @@ void DubExporter::step()
   case ExportStep::ExtractAudioTracks: {
     auto check_tracks_extracted = [this]() {
       d->numberOfAudioTracksExtracted += 1;
-      if (d->numberOfAudioTracksExtracted == 2)
+      if (d->numberOfAudioTracksExtracted == numberOfSourceRanges())
       {
         measureTracksSampleRate();
         advanceToNextStep();
@@ -301,36 +472,38 @@ void DubExporter::step()
       }
     };
 
-    // extract audio 1
+    // we only decode the parts of each audio track that are actually
+    // used in the output.
+    const QString source_paths[2] = {project().resolvePath(project().videoFilePath()),
+                                     project().resolvePath(project().audioSourceFilePath())};
+
+    for (int source_id : {0, 1})
     {
-      QStringList args;
-      args << "-y"
-           << "-i" << project().resolvePath(project().videoFilePath());
-      args << "-map_metadata"
-           << "-1";
-      args << "-map"
-           << "0:1";
-      args << "-ac"
-           << "1";
-      args << source_audio1_path;
-      run("ffmpeg", args, check_tracks_extracted);
+      const std::vector<TimeSegment>& ranges = d->sourceRanges[source_id];
+
+      for (size_t i(0); i < ranges.size(); ++i)
+      {
+        QStringList args;
+        args << "-y"
+             << "-hide_banner"
+             << "-nostats";
+        args << "-ss" << Duration(ranges[i].start()).toString(Duration::HHMMSSzzz);
+        args << "-t" << Duration(ranges[i].duration()).toString(Duration::HHMMSSzzz);
+        args << "-i" << source_paths[source_id];
+        args << "-map_metadata"
+             << "-1";
+        args << "-map"
+             << "0:1";
+        args << "-ac"
+             << "1";
+        args << sourceRangeFilePath(source_id, i);
+        run("ffmpeg", args, check_tracks_extracted);
+      }
     }
 
-    // extract audio 2
+    if (numberOfSourceRanges() == 0)
     {
-      QStringList args;
-      args << "-y"
-           << "-hide_banner"
-           << "-nostats"
-           << "-i" << project().resolvePath(project().audioSourceFilePath());
-      args << "-map_metadata"
-           << "-1";
-      args << "-map"
-           << "0:1";
-      args << "-ac"
-           << "1";
-      args << source_audio2_path;
-      run("ffmpeg", args, check_tracks_extracted);
+      advanceToNextStep();
     }
 
     return;
@@ -339,6 +512,14 @@ void DubExporter::step()
   case ExportStep::MeasureGain: {
     //ffmpeg -hide_banner -nostats -i Digi2x01.mkv -filter:a astats=measure_overall=Peak_level:measure_perchannel=0 -f null -
 
+    const std::vector<TimeSegment>& ranges = d->sourceRanges[1];
+
+    if (ranges.empty())
+    {
+      advanceToNextStep();
+      return;
+    }
+
     auto parse_audio_gain = [this]() {
       auto* process = qobject_cast<QProcess*>(sender());
       std::optional<double> dblevel = extractPeakLevel(process->readAllStandardError());
@@ -351,12 +532,20 @@ void DubExporter::step()
       advanceToNextStep();
     };
 
+    // the peak level is measured over the parts of the track that are used.
     QStringList args;
     args << "-hide_banner"
          << "-nostats";
-    args << "-i" << source_audio2_path;
-    args << "-filter:a"
-         << "astats=measure_overall=Peak_level:measure_perchannel=0";
+    QString inputs;
+    for (size_t i(0); i < ranges.size(); ++i)
+    {
+      args << "-i" << sourceRangeFilePath(1, i);
+      inputs += QString("[%1:a]").arg(QString::number(i));
+    }
+    args << "-filter_complex"
+         << inputs
+                + QString("concat=n=%1:v=0:a=1,").arg(QString::number(ranges.size()))
+                + "astats=measure_overall=Peak_level:measure_perchannel=0";
     args << "-f"
          << "null"
          << "-";
@@ -390,26 +579,30 @@ void DubExporter::step()
     {
       const OutputSegment& seg = d->osegs[i];
 
+      // the segment is cut from the decoded range that contains it,
+      // so timestamps are relative to the start of that range
+      // (dubCompute() gives no empty segment, which would be in no range).
+      const size_t range_index = findSourceRange(seg.source_id, seg.source_segment);
+      const TimeSegment& range = d->sourceRanges[seg.source_id].at(range_index);
+      const TimeSegment local_segment{seg.source_segment.start() - range.start(),
+                                      seg.source_segment.end() - range.start()};
+
+      QStringList args;
+      args << "-y";
+      args << "-i" << sourceRangeFilePath(seg.source_id, range_index);
+      args << "-ss" << Duration(local_segment.start()).toString(Duration::HHMMSSzzz);
+      args << "-to" << Duration(local_segment.end()).toString(Duration::HHMMSSzzz);
+
       if (seg.source_id == 0)
       {
-        QStringList args;
-        args << "-y";
-        args << "-i" << source_audio1_path;
-        args << "-ss" << Duration(seg.source_segment.start()).toString(Duration::HHMMSSzzz);
-        args << "-to" << Duration(seg.source_segment.end()).toString(Duration::HHMMSSzzz);
         args << tempDir.filePath(QString::number(i) + ".wav");
-        d->audioTrackProcs.push_back(run("ffmpeg", args, check_segments_extracted));
       }
       else
       {
-        QStringList args;
-        args << "-y";
-        args << "-i" << source_audio2_path;
-        args << "-ss" << Duration(seg.source_segment.start()).toString(Duration::HHMMSSzzz);
-        args << "-to" << Duration(seg.source_segment.end()).toString(Duration::HHMMSSzzz);
         args << tempDir.filePath(QString::number(i) + "-orig.wav");
-        d->audioTrackProcs.push_back(run("ffmpeg", args, check_segments_extracted));
       }
+
+      d->audioTrackProcs.push_back(run("ffmpeg", args, check_segments_extracted, int(i)));
     }
 
     return;
@@ -470,18 +663,24 @@ void DubExporter::step()
           args << audiofilters.join(',');
         }
 
-        if (d->trackSampleRates[0] != d->trackSampleRates[1])
+        if (d->trackSampleRates[0] && d->trackSampleRates[0] != d->trackSampleRates[1])
         {
           args << "-ar" << QString::number(d->trackSampleRates[0]);
         }
 
         args << outputpath;
 
-        QProcess* proc = run("ffmpeg", args, check_audio_postprocessing);
+        QProcess* proc = run("ffmpeg", args, check_audio_postprocessing, int(i));
         d->audioTrackProcs.push_back(proc);
       }
     }
 
+    // e.g. if no match had anything to dub with
+    if (d->numberOfAudioSegmentsPostProcessed == d->osegs.size())
+    {
+      advanceToNextStep();
+    }
+
     return;
   }
 
@@ -537,14 +736,14 @@ void DubExporter::step()
       args << "-c:a"
            << "copy";
 
-      args << outputFilePath();
+      args << partialOutputFilePath();
       d->mkvmerge = run("mkvmerge", args, &DubExporter::advanceToNextStep);
     }
     else
     {
       //mkvmerge -o output/Digimon.S1.E01.mkv --default-track-flag 1:0 Digimon.S1.E01.mkv --track-name "0:Mono - FR (Mixed)" --language 0:fre --default-track-flag 0:1 --original-flag 0 -a 0 output/concat.mka
       QStringList args;
-      args << "-o" << outputFilePath();
+      args << "-o" << partialOutputFilePath();
 
       if (!project().projectTitle().isEmpty())
       {
@@ -597,8 +796,31 @@ void DubExporter::step()
       qDebug() << std_out;
     }
 
+    // the output is written under a temporary name and only renamed on success,
+    // so that an interrupted export never looks complete.
+    // mkvmerge returns 1 for warnings and 2 for errors.
+    if (d->mkvmerge->exitStatus() == QProcess::NormalExit && d->mkvmerge->exitCode() < 2)
+    {
+      QFile::remove(outputFilePath());
+      m_succeeded = QFile::rename(partialOutputFilePath(), outputFilePath());
+    }
+
+    if (!m_succeeded)
+    {
+      qDebug() << "could not write" << outputFilePath();
+      QFile::remove(partialOutputFilePath());
+    }
+
     d->mkvmerge->deleteLater();
     d->mkvmerge = nullptr;
+
+    m_report.wallTime = d->timer.elapsed();
+    m_report.cpuTime = d->cpuTimer.elapsed();
+    if (!m_report.save(reportFilePath()))
+    {
+      qDebug() << "could not write" << reportFilePath();
+    }
+
     d.reset();
     Q_EMIT finished();
     return;
@@ -609,6 +831,20 @@ void DubExporter::step()
 
 void DubExporter::advanceToNextStep()
 {
+  const int64_t now = d->timer.elapsed();
+  ExportStepStats& step_stats = m_report.steps.at(static_cast<int>(d->currentStep) - 1);
+  step_stats.wallTime = now - d->stepStartTime;
+  d->stepStartTime = now;
+  // all the processes of the step have ended
+  step_stats.cpuTime = d->stepCpuTimer.elapsed();
+  d->stepCpuTimer.start();
+
+  if (d->profileTrack)
+  {
+    profileSpan("export", step_description(d->currentStep), d->stepProfileStartTime, d->profileTrack, outputFilePath());
+    d->stepProfileStartTime = profilingClock();
+  }
+
   d->currentStep = static_cast<ExportStep>(static_cast<int>(d->currentStep) + 1);
   d->waiting = false;
 
@@ -619,23 +855,89 @@ void DubExporter::advanceToNextStep()
 }
 
 template<typename Callback>
-QProcess* DubExporter::run(const QString& program, const QStringList& args, Callback&& onFinished)
+QProcess* DubExporter::run(const QString& program, const QStringList& args, Callback&& onFinished, int segment)
 {
-  QProcess* process = ::run(program, args);
+  QProcess* process = m_processPool ? m_processPool->run(program, args) : ::run(program, args);
   process->setParent(this);
+  setProcessCpuTimeGroup(*process, this);
+
+  // a process from the pool may have to wait before being started
+  auto set_start_time = [this, process]() { process->setProperty("exportStartTime", qint64(d->timer.elapsed())); };
+  if (process->state() == QProcess::NotRunning)
+  {
+    connect(process, &QProcess::started, this, set_start_time);
+  }
+  else
+  {
+    set_start_time();
+  }
+
+  // stats are recorded before the callback, which may advance to the next step
+  const int step_index = static_cast<int>(d->currentStep) - 1;
+  connect(process, &QProcess::finished, this, [this, process, step_index, segment]() {
+    recordProcessStats(*process, step_index, segment);
+  });
+
   connect(process, &QProcess::finished, this, std::forward<Callback>(onFinished));
   d->waiting = true;
   return process;
 }
 
-void DubExporter::measureTracksSampleRate()
+void DubExporter::recordProcessStats(QProcess& process, int stepIndex, int segment)
+{
+  const int64_t wall_time = d->timer.elapsed() - process.property("exportStartTime").toLongLong();
+  const int64_t cpu_time = processCpuTime(process);
+  const QString output_path = output_file_path(process.program(), process.arguments());
+  const int64_t bytes_written = output_path.isEmpty() ? 0 : QFileInfo(output_path).size();
+
+  ExportStepStats& step = m_report.steps.at(stepIndex);
+  step.numberOfProcesses += 1;
+  step.bytesWritten += bytes_written;
+
+  if (segment != -1)
+  {
+    ExportSegmentStats& seg = m_report.segments.at(segment);
+    seg.wallTime += wall_time;
+    // an unknown cpu time makes the sum unknown
+    seg.cpuTime = (seg.cpuTime < 0 || cpu_time < 0) ? -1 : seg.cpuTime + cpu_time;
+    seg.numberOfProcesses += 1;
+    seg.bytesWritten += bytes_written;
+  }
+}
+
+int DubExporter::numberOfSourceRanges() const
+{
+  return int(d->sourceRanges[0].size() + d->sourceRanges[1].size());
+}
+
+QString DubExporter::sourceRangeFilePath(int sourceId, size_t rangeIndex) const
 {
-  auto& tempDir = d->tempDir;
-  const QString source_audio1_path = tempDir.filePath("src1.wav");
-  const QString source_audio2_path = tempDir.filePath("src2.wav");
+  return d->tempDir.filePath(
+      QString("src%1-%2.wav").arg(QString::number(sourceId + 1), QString::number(rangeIndex)));
+}
+
+size_t DubExporter::findSourceRange(int sourceId, const TimeSegment& segment) const
+{
+  const std::vector<TimeSegment>& ranges = d->sourceRanges[sourceId];
+
+  auto it = std::upper_bound(ranges.begin(),
+                             ranges.end(),
+                             segment.start(),
+                             [](int64_t val, const TimeSegment& e) { return val < e.start(); });
+
+  Q_ASSERT(it != ranges.begin());
+  return std::distance(ranges.begin(), it) - 1;
+}
 
-  d->trackSampleRates[0] = readWavSampleRate(source_audio1_path);
-  d->trackSampleRates[1] = readWavSampleRate(source_audio2_path);
+void DubExporter::measureTracksSampleRate()
+{
+  for (int source_id : {0, 1})
+  {
+    if (!d->sourceRanges[source_id].empty())
+    {
+      d->trackSampleRates[source_id] = readWavSampleRate(sourceRangeFilePath(source_id, 0));
+    }
+  }
 
   qDebug() << "Sample rate of track 1:" << d->trackSampleRates[0];
   qDebug() << "Sample rate of track 2:" << d->trackSampleRates[1];
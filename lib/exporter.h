@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "exportreport.h"
 #include "timesegment.h"
 
 #include <QObject>
@@ -14,6 +15,7 @@ class QProcess;
 
 class DubbingProject;
 class MediaObject;
+class ProcessPool;
 
 struct OutputSegment
 {
@@ -24,6 +26,10 @@ struct OutputSegment
 
 std::vector<OutputSegment> dubCompute(const DubbingProject& project, const MediaObject& video);
 
+std::vector<TimeSegment> computeSourceRanges(const std::vector<OutputSegment>& segments,
+                                             int sourceId,
+                                             int64_t maxGap);
+
 void exportProject(const DubbingProject& project,
                    const MediaObject& video,
                    const QString& outputFilePath);
@@ -44,14 +50,22 @@ public:
   const QString& outputFilePath() const;
   void setOutputFilePath(const QString& path);
 
+  ProcessPool* processPool() const;
+  void setProcessPool(ProcessPool* pool);
+
   void run();
   bool isRunning() const;
+  // Whether the last export that finished wrote its output.
+  bool succeeded() const;
 
   QString status() const;
   float progress() const;
 
   void waitForFinished();
 
+  const ExportReport& report() const;
+  QString reportFilePath() const;
+
 Q_SIGNALS:
   void statusChanged();
   void progressChanged();
@@ -63,15 +77,23 @@ private Q_SLOTS:
 
 private:
   template<typename Callback>
-  QProcess* run(const QString& program, const QStringList& args, Callback&& onFinished);
+  QProcess* run(const QString& program, const QStringList& args, Callback&& onFinished, int segment = -1);
+  void recordProcessStats(QProcess& process, int stepIndex, int segment);
 
 private:
+  QString partialOutputFilePath() const;
+  int numberOfSourceRanges() const;
+  QString sourceRangeFilePath(int sourceId, size_t rangeIndex) const;
+  size_t findSourceRange(int sourceId, const TimeSegment& segment) const;
   void measureTracksSampleRate();
 
 private:
   const DubbingProject& m_project;
   const MediaObject& m_video;
   QString m_outputFilePath;
+  ProcessPool* m_processPool = nullptr;
+  ExportReport m_report;
+  bool m_succeeded = false;
   struct Data;
   std::unique_ptr<Data> d;
 };
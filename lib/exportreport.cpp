@@ -0,0 +1,137 @@
+#include "exportreport.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <QTextStream>
+
+#include <algorithm>
+#include <numeric>
+
+int ExportReport::numberOfProcesses() const
+{
+  return std::accumulate(steps.begin(), steps.end(), 0, [](int n, const ExportStepStats& e) {
+    return n + e.numberOfProcesses;
+  });
+}
+
+int64_t ExportReport::bytesWritten() const
+{
+  return std::accumulate(steps.begin(), steps.end(), int64_t(0), [](int64_t n, const ExportStepStats& e) {
+    return n + e.bytesWritten;
+  });
+}
+
+static QJsonValue cpu_time_json(int64_t msecs)
+{
+  return msecs < 0 ? QJsonValue() : QJsonValue(qint64(msecs));
+}
+
+QJsonObject ExportReport::toJson() const
+{
+  QJsonObject result;
+  result["title"] = projectTitle;
+  result["output"] = outputFilePath;
+  result["start_time"] = startTime.toString(Qt::ISODate);
+  result["wall_time"] = qint64(wallTime);
+  result["cpu_time"] = cpu_time_json(cpuTime);
+  result["processes"] = numberOfProcesses();
+  result["bytes_written"] = qint64(bytesWritten());
+
+  QJsonArray jsteps;
+  for (const ExportStepStats& step : steps)
+  {
+    QJsonObject obj;
+    obj["name"] = step.name;
+    obj["wall_time"] = qint64(step.wallTime);
+    obj["cpu_time"] = cpu_time_json(step.cpuTime);
+    obj["processes"] = step.numberOfProcesses;
+    obj["bytes_written"] = qint64(step.bytesWritten);
+    jsteps.append(obj);
+  }
+  result["steps"] = jsteps;
+
+  QJsonArray jsegments;
+  for (const ExportSegmentStats& seg : segments)
+  {
+    QJsonObject obj;
+    obj["source"] = seg.sourceId;
+    obj["output_segment"] = seg.outputSegment.toString();
+    obj["source_segment"] = seg.sourceSegment.toString();
+    obj["wall_time"] = qint64(seg.wallTime);
+    obj["cpu_time"] = cpu_time_json(seg.cpuTime);
+    obj["processes"] = seg.numberOfProcesses;
+    obj["bytes_written"] = qint64(seg.bytesWritten);
+    jsegments.append(obj);
+  }
+  result["segments"] = jsegments;
+
+  return result;
+}
+
+static QString format_msecs(int64_t msecs)
+{
+  return QString::number(msecs / 1000., 'f', 2) + "s";
+}
+
+static QString format_cpu_time(int64_t msecs)
+{
+  return msecs < 0 ? QString("n/a") : format_msecs(msecs);
+}
+
+static QString format_bytes(int64_t bytes)
+{
+  return QString::number(bytes / (1024. * 1024.), 'f', 1) + " MB";
+}
+
+QString ExportReport::summary() const
+{
+  QString result;
+  QTextStream out{&result};
+
+  out << "Export of " << projectTitle << " took " << format_msecs(wallTime) << " ("
+      << numberOfProcesses() << " processes, cpu " << format_cpu_time(cpuTime) << ", "
+      << format_bytes(bytesWritten()) << " written)\n";
+
+  for (const ExportStepStats& step : steps)
+  {
+    out << "  " << step.name.leftJustified(32) << format_msecs(step.wallTime).rightJustified(10)
+        << " cpu " << format_cpu_time(step.cpuTime).rightJustified(10) << QString::number(step.numberOfProcesses).rightJustified(6)
+        << " proc " << format_bytes(step.bytesWritten).rightJustified(12) << "\n";
+  }
+
+  // the slowest segments
+  std::vector<size_t> indices(segments.size());
+  std::iota(indices.begin(), indices.end(), size_t(0));
+  std::sort(indices.begin(), indices.end(), [this](size_t a, size_t b) {
+    return segments.at(a).wallTime > segments.at(b).wallTime;
+  });
+
+  if (!indices.empty())
+  {
+    out << "  slowest segments:";
+    for (size_t i(0); i < std::min<size_t>(indices.size(), 3); ++i)
+    {
+      const ExportSegmentStats& seg = segments.at(indices.at(i));
+      out << " #" << indices.at(i) << " " << seg.outputSegment.toString() << " ("
+          << format_msecs(seg.wallTime) << ")";
+    }
+    out << "\n";
+  }
+
+  return result;
+}
+
+bool ExportReport::save(const QString& filePath) const
+{
+  QFile file{filePath};
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    return false;
+  }
+
+  file.write(QJsonDocument(toJson()).toJson());
+  return true;
+}
@@ -0,0 +1,54 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include "timesegment.h"
+
+#include <QDateTime>
+#include <QString>
+
+#include <vector>
+
+class QJsonObject;
+
+// Times are in msecs, sizes in bytes; a cpu time of -1 is unknown.
+
+struct ExportStepStats
+{
+  QString name;
+  int64_t wallTime = 0;
+  int64_t cpuTime = 0; // cpu time of the child processes, see ChildrenCpuTimer
+  int numberOfProcesses = 0;
+  int64_t bytesWritten = 0;
+};
+
+struct ExportSegmentStats
+{
+  int sourceId = 0;
+  TimeSegment outputSegment;
+  TimeSegment sourceSegment;
+  int64_t wallTime = 0; // sum of the wall time of the processes working on this segment
+  int64_t cpuTime = 0; // see processCpuTime()
+  int numberOfProcesses = 0;
+  int64_t bytesWritten = 0;
+};
+
+struct ExportReport
+{
+  QString projectTitle;
+  QString outputFilePath;
+  QDateTime startTime;
+  int64_t wallTime = 0;
+  int64_t cpuTime = 0; // of all the child processes
+  std::vector<ExportStepStats> steps;
+  std::vector<ExportSegmentStats> segments;
+
+  int numberOfProcesses() const;
+  int64_t bytesWritten() const;
+
+  QJsonObject toJson() const;
+  QString summary() const;
+  bool save(const QString& filePath) const;
+};
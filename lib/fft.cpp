@@ -0,0 +1,105 @@
+#include "fft.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+FFT::FFT(size_t size)
+    : m_size(size)
+{
+  assert(std::has_single_bit(size));
+
+  // the twiddle factors of each stage are stored contiguously:
+  // stage `len` uses m_twiddles[len / 2 - 1 + j] = exp(-2 * pi * i * j / len) for j < len / 2.
+  m_twiddles.resize(size > 1 ? size - 1 : 0);
+  for (size_t len = 2; len <= size; len *= 2)
+  {
+    for (size_t j(0); j < len / 2; ++j)
+    {
+      const double angle = -2 * std::numbers::pi * double(j) / double(len);
+      m_twiddles[len / 2 - 1 + j] = std::complex<double>(std::cos(angle), std::sin(angle));
+    }
+  }
+
+  const int nbits = std::countr_zero(size);
+  m_bitReversal.resize(size);
+  for (size_t i(0); i < size; ++i)
+  {
+    uint32_t r = 0;
+    for (int b(0); b < nbits; ++b)
+    {
+      r |= ((i >> b) & 1) << (nbits - 1 - b);
+    }
+    m_bitReversal[i] = r;
+  }
+}
+
+size_t FFT::sizeFor(size_t n)
+{
+  return std::bit_ceil(std::max<size_t>(n, 1));
+}
+
+void FFT::forward(std::complex<double>* data) const
+{
+  transform(data);
+}
+
+void FFT::inverse(std::complex<double>* data) const
+{
+  for (size_t i(0); i < m_size; ++i)
+  {
+    data[i] = std::conj(data[i]);
+  }
+
+  transform(data);
+
+  for (size_t i(0); i < m_size; ++i)
+  {
+    data[i] = std::conj(data[i]);
+  }
+}
+
+void FFT::transform(std::complex<double>* data) const
+{
+  for (size_t i(0); i < m_size; ++i)
+  {
+    const size_t j = m_bitReversal[i];
+    if (i < j)
+    {
+      std::swap(data[i], data[j]);
+    }
+  }
+
+  // products are written out by hand: std::complex's operator* handles
+  // infinities and NaNs and is much slower.
+  auto* values = reinterpret_cast<double*>(data);
+
+  for (size_t len = 2; len <= m_size; len *= 2)
+  {
+    const size_t half = len / 2;
+    const auto* twiddles = reinterpret_cast<const double*>(m_twiddles.data() + half - 1);
+
+    for (size_t i(0); i < m_size; i += len)
+    {
+      double* a = values + 2 * i;
+      double* b = values + 2 * (i + half);
+
+      for (size_t j(0); j < half; ++j)
+      {
+        const double wr = twiddles[2 * j];
+        const double wi = twiddles[2 * j + 1];
+        const double vr = b[2 * j] * wr - b[2 * j + 1] * wi;
+        const double vi = b[2 * j] * wi + b[2 * j + 1] * wr;
+        const double ur = a[2 * j];
+        const double ui = a[2 * j + 1];
+        a[2 * j] = ur + vr;
+        a[2 * j + 1] = ui + vi;
+        b[2 * j] = ur - vr;
+        b[2 * j + 1] = ui - vi;
+      }
+    }
+  }
+}
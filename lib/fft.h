@@ -0,0 +1,42 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// In-place radix-2 complex FFT.
+class FFT
+{
+public:
+  explicit FFT(size_t size);
+
+  size_t size() const;
+
+  void forward(std::complex<double>* data) const;
+  // Not normalized: inverse(forward(x)) == size() * x.
+  void inverse(std::complex<double>* data) const;
+
+  // Returns the smallest power of two greater or equal to n.
+  static size_t sizeFor(size_t n);
+
+private:
+  void transform(std::complex<double>* data) const;
+
+private:
+  size_t m_size;
+  std::vector<std::complex<double>> m_twiddles;
+  std::vector<uint32_t> m_bitReversal;
+};
+
+inline size_t FFT::size() const
+{
+  return m_size;
+}
+
+#endif // FFT_H
@@ -0,0 +1,250 @@
+#include "framecodec.h"
+
+#include <bit>
+#include <limits>
+
+namespace {
+
+// hashes differing from the previous one by more bits are written in full
+constexpr int max_sparse_bits = 7;
+constexpr uchar full_hash_tag = 0xff;
+// larger than any difference of two int, so that the pts cannot overflow while decoded
+constexpr qint64 max_pts_delta = qint64(1) << 32;
+
+void write_varint(QByteArray& out, quint64 value)
+{
+  while (value >= 0x80)
+  {
+    out.append(char(value | 0x80));
+    value >>= 7;
+  }
+  out.append(char(value));
+}
+
+quint64 zigzag(qint64 value)
+{
+  return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+  return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+class Reader
+{
+public:
+  explicit Reader(std::span<const uchar> data)
+      : m_data(data)
+  {}
+
+  bool atEnd() const { return m_pos == m_data.size(); }
+
+  bool readByte(uchar& value)
+  {
+    if (m_pos == m_data.size())
+    {
+      return false;
+    }
+    value = m_data[m_pos++];
+    return true;
+  }
+
+  bool readVarint(quint64& value)
+  {
+    value = 0;
+    for (int shift(0); shift < 64; shift += 7)
+    {
+      uchar byte;
+      if (!readByte(byte))
+      {
+        return false;
+      }
+      value |= quint64(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::span<const uchar> m_data;
+  size_t m_pos = 0;
+};
+
+} // namespace
+
+QByteArray encodePts(std::span<const int> pts)
+{
+  QByteArray result;
+
+  if (pts.empty())
+  {
+    return result;
+  }
+
+  write_varint(result, zigzag(pts.front()));
+
+  // (difference, number of times it repeats)
+  size_t i = 1;
+  while (i < pts.size())
+  {
+    const qint64 delta = qint64(pts[i]) - pts[i - 1];
+    size_t run = 1;
+    while (i + run < pts.size() && qint64(pts[i + run]) - pts[i + run - 1] == delta)
+    {
+      ++run;
+    }
+
+    write_varint(result, zigzag(delta));
+    write_varint(result, run);
+    i += run;
+  }
+
+  return result;
+}
+
+bool decodePts(std::span<const uchar> data, std::span<int> pts)
+{
+  Reader reader{data};
+
+  if (pts.empty())
+  {
+    return reader.atEnd();
+  }
+
+  quint64 value;
+  if (!reader.readVarint(value))
+  {
+    return false;
+  }
+
+  qint64 current = unzigzag(value);
+  size_t i = 0;
+
+  for (;;)
+  {
+    if (current < std::numeric_limits<int>::min() || current > std::numeric_limits<int>::max())
+    {
+      return false;
+    }
+
+    pts[i++] = int(current);
+
+    if (i == pts.size())
+    {
+      break;
+    }
+
+    quint64 run;
+    if (!reader.readVarint(value) || !reader.readVarint(run) || run == 0 || run > pts.size() - i)
+    {
+      return false;
+    }
+
+    // the last pts of the run is checked by the loop
+    const qint64 delta = unzigzag(value);
+    if (delta < -max_pts_delta || delta > max_pts_delta)
+    {
+      return false;
+    }
+
+    for (; run > 1; --run)
+    {
+      current += delta;
+      if (current < std::numeric_limits<int>::min() || current > std::numeric_limits<int>::max())
+      {
+        return false;
+      }
+      pts[i++] = int(current);
+    }
+    current += delta;
+  }
+
+  return reader.atEnd();
+}
+
+QByteArray encodeHashes(std::span<const quint64> hashes)
+{
+  QByteArray result;
+  result.reserve(hashes.size() * 3);
+
+  quint64 previous = 0;
+  for (quint64 hash : hashes)
+  {
+    quint64 diff = hash ^ previous;
+    previous = hash;
+
+    const int bits = std::popcount(diff);
+    if (bits <= max_sparse_bits)
+    {
+      result.append(char(bits));
+      for (; diff; diff &= diff - 1)
+      {
+        result.append(char(std::countr_zero(diff)));
+      }
+    }
+    else
+    {
+      result.append(char(full_hash_tag));
+      for (int i(0); i < 8; ++i)
+      {
+        result.append(char(hash >> (8 * i)));
+      }
+    }
+  }
+
+  return result;
+}
+
+bool decodeHashes(std::span<const uchar> data, std::span<quint64> hashes)
+{
+  Reader reader{data};
+
+  quint64 previous = 0;
+  for (quint64& hash : hashes)
+  {
+    uchar tag;
+    if (!reader.readByte(tag))
+    {
+      return false;
+    }
+
+    if (tag == full_hash_tag)
+    {
+      hash = 0;
+      for (int i(0); i < 8; ++i)
+      {
+        uchar byte;
+        if (!reader.readByte(byte))
+        {
+          return false;
+        }
+        hash |= quint64(byte) << (8 * i);
+      }
+    }
+    else if (tag <= max_sparse_bits)
+    {
+      hash = previous;
+      for (int i(0); i < tag; ++i)
+      {
+        uchar bit;
+        if (!reader.readByte(bit) || bit >= 64)
+        {
+          return false;
+        }
+        hash ^= quint64(1) << bit;
+      }
+    }
+    else
+    {
+      return false;
+    }
+
+    previous = hash;
+  }
+
+  return reader.atEnd();
+}
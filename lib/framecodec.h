@@ -0,0 +1,24 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <QByteArray>
+
+#include <span>
+
+// Compact encodings of the frames of a video, for the frames files of the cache.
+
+// The pts are encoded as runs of a constant difference with the previous pts,
+// which usually makes a few bytes for a whole video.
+QByteArray encodePts(std::span<const int> pts);
+// Returns false if `data` does not hold exactly `pts.size()` encoded pts.
+bool decodePts(std::span<const uchar> data, std::span<int> pts);
+
+// Each hash is XORed with the previous one; as the hashes of consecutive frames
+// are nearly identical, the result is encoded as the positions of its bits set
+// when there are few of them (the hash is written in full otherwise).
+QByteArray encodeHashes(std::span<const quint64> hashes);
+// Returns false if `data` does not hold exactly `hashes.size()` encoded hashes.
+bool decodeHashes(std::span<const uchar> data, std::span<quint64> hashes);
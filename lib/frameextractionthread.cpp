@@ -4,60 +4,24 @@
 #include "cache.h"
 #include "mediaobject.h"
 #include "phash.h"
+#include "processstats.h"
+#include "profiler.h"
 
 #include <QCoreApplication>
 
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QProcess>
 #include <QTemporaryDir>
 
-void read_frames_from_disk(std::vector<VideoFrameInfo>& frames, const QString& filePath)
-{
-  QFile file{filePath};
-  if (!file.open(QIODevice::ReadOnly))
-  {
-    qDebug() << "could not open " << filePath;
-  }
-
-  size_t n = 0;
-  QDataStream stream{&file};
-  stream >> n;
-  for (size_t i(0); i < n; ++i)
-  {
-    VideoFrameInfo f;
-    stream >> f.pts;
-    stream >> f.phash;
-    frames.push_back(f);
-  }
-
-  if (!file.atEnd())
-  {
-    qDebug() << "warning: not at end of file " << filePath;
-  }
-}
-
-void save_frames_to_disk(const std::vector<VideoFrameInfo>& frames, const QString& filePath)
-{
-  QFile file{filePath};
-  if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
-  {
-    qDebug() << "could not write " << filePath;
-  }
-
-  QDataStream stream{&file};
-  stream << size_t(frames.size());
-  for (const VideoFrameInfo& e : frames)
-  {
-    stream << e.pts << e.phash;
-  }
-}
-
 void collect_frames(std::vector<VideoFrameInfo>& frames, const QDir& dir)
 {
   QStringList names = dir.entryList(QStringList() << "*.png");
   //qDebug() << names.size();
 
+  ProfileScope profile_scope{"media", "collect_frames", QString::number(names.size()) + " frames"};
+
   PerceptualHash hash;
 
   for (const QString& name : names)
@@ -73,28 +37,44 @@ void collect_frames(std::vector<VideoFrameInfo>& frames, const QDir& dir)
 
 FrameExtractionThread::FrameExtractionThread(const MediaObject& media)
     : m_filePath(media.filePath())
-    , m_nbFrames(media.numberOfPackets())
+    , m_cacheKey(media.cacheKey())
+    , m_frameRate(media.frameRateAsRational())
+    , m_nbFrames(media.estimatedNumberOfFrames())
 {
   CreateCacheDir();
 }
 
 FrameExtractionThread::~FrameExtractionThread() {}
 
-std::vector<VideoFrameInfo>& FrameExtractionThread::frames()
+QString FrameExtractionThread::cacheFilePath(const QString& cacheKey)
+{
+  // the hashes depend on the scaling of the frames
+  return GetCacheFilePath(cacheKey, "frames", "format=gray,scale=32:32;phash");
+}
+
+std::unique_ptr<FramesInfo> FrameExtractionThread::takeFrames()
 {
   assert(isFinished());
-  return m_frames;
+  return std::move(m_frames);
 }
 
 void FrameExtractionThread::run()
 {
-  const QString search_filepath = GetCacheDir() + "/" + QFileInfo(m_filePath).fileName() + "."
-                                  + QString::number(m_nbFrames);
+  ProfileScope profile_scope{"media", "FrameExtractionThread::run", QFileInfo(m_filePath).fileName()};
+
+  const QString search_filepath = cacheFilePath(m_cacheKey);
 
   if (QFileInfo::exists(search_filepath))
   {
-    read_frames_from_disk(m_frames, search_filepath);
-    return;
+    m_frames = FramesInfo::load(search_filepath, m_cacheKey);
+    if (m_frames)
+    {
+      return;
+    }
+    else
+    {
+      QFile::remove(search_filepath);
+    }
   }
 
   QTemporaryDir temp_dir;
@@ -102,6 +82,7 @@ void FrameExtractionThread::run()
   if (!temp_dir.isValid())
   {
     qDebug() << "invalid temp dir";
+    m_frames = std::make_unique<FramesInfo>();
     return;
   }
 
@@ -125,12 +106,15 @@ void FrameExtractionThread::run()
        << "true" << QString("%1/%d.png").arg(temp_dir.path());
 
   ffmpeg.setArguments(args);
+  profileProcess(ffmpeg);
+  watchProcessCpuTime(ffmpeg);
   qDebug() << args.join(" ");
 
   ffmpeg.start();
   ffmpeg.waitForStarted();
 
-  m_frames.reserve(m_nbFrames);
+  std::vector<VideoFrameInfo> frames;
+  frames.reserve(m_nbFrames);
 
   for (;;)
   {
@@ -138,9 +122,9 @@ void FrameExtractionThread::run()
 
     QCoreApplication::processEvents();
 
-    collect_frames(m_frames, QDir(temp_dir.path()));
+    collect_frames(frames, QDir(temp_dir.path()));
 
-    const float progress = m_frames.size() / float(m_nbFrames);
+    const float progress = std::min(frames.size() / float(m_nbFrames), 1.f);
     emit progressChanged(progress);
 
     if (ffmpeg.state() == QProcess::NotRunning)
@@ -149,9 +133,11 @@ void FrameExtractionThread::run()
     }
   }
 
-  std::sort(m_frames.begin(), m_frames.end(), [](const VideoFrameInfo& a, const VideoFrameInfo& b) {
+  std::sort(frames.begin(), frames.end(), [](const VideoFrameInfo& a, const VideoFrameInfo& b) {
     return a.pts < b.pts;
   });
 
-  save_frames_to_disk(m_frames, search_filepath);
+  m_frames = std::make_unique<FramesInfo>(frames);
+  // raw, so that the next loads map the file instead of decoding it
+  m_frames->save(search_filepath, m_frameRate, m_cacheKey, FramesInfo::Raw);
 }
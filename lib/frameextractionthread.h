@@ -4,10 +4,12 @@
 
 #pragma once
 
-#include "mediainfo.h"
+#include "framesinfo.h"
 
 #include <QThread>
 
+#include <memory>
+
 class MediaObject;
 
 class FrameExtractionThread : public QThread
@@ -17,7 +19,11 @@ public:
   explicit FrameExtractionThread(const MediaObject& media);
   ~FrameExtractionThread();
 
-  std::vector<VideoFrameInfo>& frames();
+  // The frames are mapped from the cache file if it was valid.
+  std::unique_ptr<FramesInfo> takeFrames();
+
+  // path of the cache file of the media with the given cache key
+  static QString cacheFilePath(const QString& cacheKey);
 
 Q_SIGNALS:
   void progressChanged(float value);
@@ -27,6 +33,9 @@ protected:
 
 private:
   QString m_filePath;
+  QString m_cacheKey;
+  std::pair<int, int> m_frameRate;
+  // estimated, for the progress
   int m_nbFrames;
-  std::vector<VideoFrameInfo> m_frames;
+  std::unique_ptr<FramesInfo> m_frames;
 };
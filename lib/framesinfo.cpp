@@ -0,0 +1,243 @@
+#include "framesinfo.h"
+
+#include "framecodec.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+// Layout of a frames file, in the byte order of the machine that wrote it
+// (the version is then read wrong on another one, and the file rejected):
+// the header, then the pts and the hashes, each starting on a cache line,
+// either as arrays or encoded as by framecodec.h.
+struct FramesFileHeader
+{
+  char magic[8];
+  quint32 version;
+  quint32 header_size;
+  quint64 count;
+  qint32 frame_rate_num;
+  qint32 frame_rate_den;
+  char fingerprint[40]; // zero-padded
+  quint32 encoding;     // FramesInfo::Encoding
+  quint32 reserved;
+  quint64 pts_offset;
+  quint64 pts_size;
+  quint64 hashes_offset;
+  quint64 hashes_size;
+  quint64 checksum; // of the header (with a zero checksum), and of the pts and hashes as stored
+};
+
+static constexpr char frames_file_magic[8] = {'D', 'D', 'F', 'R', 'A', 'M', 'E', 'S'};
+static constexpr quint32 frames_file_version = 2;
+static constexpr quint64 frames_file_alignment = 64;
+
+static quint64 align_offset(quint64 offset)
+{
+  return (offset + frames_file_alignment - 1) / frames_file_alignment * frames_file_alignment;
+}
+
+// FNV-1a on 64-bit words, which is fast enough to be checked each time the file is mapped.
+static quint64 checksum(quint64 hash, const uchar* data, size_t size)
+{
+  constexpr quint64 prime = 0x100000001b3;
+
+  size_t i = 0;
+  for (; i + sizeof(quint64) <= size; i += sizeof(quint64))
+  {
+    quint64 word;
+    std::memcpy(&word, data + i, sizeof(quint64));
+    hash = (hash ^ word) * prime;
+  }
+
+  for (; i < size; ++i)
+  {
+    hash = (hash ^ data[i]) * prime;
+  }
+
+  return hash;
+}
+
+static quint64 checksum(FramesFileHeader header, std::span<const uchar> pts, std::span<const uchar> hashes)
+{
+  header.checksum = 0;
+  quint64 result = 0xcbf29ce484222325;
+  result = checksum(result, reinterpret_cast<const uchar*>(&header), sizeof(FramesFileHeader));
+  result = checksum(result, pts.data(), pts.size());
+  result = checksum(result, hashes.data(), hashes.size());
+  return result;
+}
+
+FramesInfo::FramesInfo() {}
+
+FramesInfo::FramesInfo(const std::vector<VideoFrameInfo>& frames)
+{
+  m_ownedPts.reserve(frames.size());
+  m_ownedHashes.reserve(frames.size());
+
+  for (const VideoFrameInfo& f : frames)
+  {
+    m_ownedPts.push_back(f.pts);
+    m_ownedHashes.push_back(f.phash);
+  }
+
+  m_pts = m_ownedPts;
+  m_hashes = m_ownedHashes;
+}
+
+FramesInfo::~FramesInfo() {}
+
+std::unique_ptr<FramesInfo> FramesInfo::load(const QString& filePath, const QString& fingerprint)
+{
+  auto file = std::make_unique<QFile>(filePath);
+  if (!file->open(QIODevice::ReadOnly))
+  {
+    qDebug() << "could not open " << filePath;
+    return nullptr;
+  }
+
+  const quint64 size = file->size();
+  if (size < sizeof(FramesFileHeader))
+  {
+    return nullptr;
+  }
+
+  const uchar* data = file->map(0, size);
+  if (!data)
+  {
+    qDebug() << "could not map " << filePath;
+    return nullptr;
+  }
+
+  FramesFileHeader header;
+  std::memcpy(&header, data, sizeof(FramesFileHeader));
+
+  if (std::memcmp(header.magic, frames_file_magic, sizeof(frames_file_magic)) != 0
+      || header.version != frames_file_version || header.header_size != sizeof(FramesFileHeader))
+  {
+    qDebug() << filePath << "is not a frames file of version" << frames_file_version;
+    return nullptr;
+  }
+
+  // the offsets are checked without overflowing, as they may be anything;
+  // an encoded frame takes at least one byte
+  const bool raw = header.encoding == Raw;
+  if ((header.encoding != Raw && header.encoding != Packed) || header.count > size
+      || header.pts_offset % frames_file_alignment != 0 || header.hashes_offset % frames_file_alignment != 0
+      || header.pts_offset > size || header.pts_size > size - header.pts_offset || header.hashes_offset > size
+      || header.hashes_size > size - header.hashes_offset
+      || (raw
+          && (header.pts_size != header.count * sizeof(int)
+              || header.hashes_size != header.count * sizeof(quint64))))
+  {
+    qDebug() << "bad header in " << filePath;
+    return nullptr;
+  }
+
+  if (!fingerprint.isEmpty()
+      && QString::fromLatin1(header.fingerprint, qstrnlen(header.fingerprint, sizeof(header.fingerprint)))
+             != fingerprint)
+  {
+    qDebug() << filePath << "was written for another file";
+    return nullptr;
+  }
+
+  const std::span<const uchar> pts_data{data + header.pts_offset, size_t(header.pts_size)};
+  const std::span<const uchar> hashes_data{data + header.hashes_offset, size_t(header.hashes_size)};
+
+  if (checksum(header, pts_data, hashes_data) != header.checksum)
+  {
+    qDebug() << "corrupt frames in " << filePath;
+    return nullptr;
+  }
+
+  auto result = std::make_unique<FramesInfo>();
+
+  if (raw)
+  {
+    // the arrays are used in place
+    result->m_pts = std::span(reinterpret_cast<const int*>(pts_data.data()), size_t(header.count));
+    result->m_hashes = std::span(reinterpret_cast<const quint64*>(hashes_data.data()), size_t(header.count));
+    result->m_file = std::move(file);
+  }
+  else
+  {
+    result->m_ownedPts.resize(header.count);
+    result->m_ownedHashes.resize(header.count);
+    if (!decodePts(pts_data, result->m_ownedPts) || !decodeHashes(hashes_data, result->m_ownedHashes))
+    {
+      qDebug() << "corrupt frames in " << filePath;
+      return nullptr;
+    }
+    result->m_pts = result->m_ownedPts;
+    result->m_hashes = result->m_ownedHashes;
+  }
+
+  if (!std::is_sorted(result->m_pts.begin(), result->m_pts.end()))
+  {
+    qDebug() << "corrupt frames in " << filePath;
+    return nullptr;
+  }
+
+  result->m_frameRate = std::make_pair(header.frame_rate_num, header.frame_rate_den);
+  return result;
+}
+
+bool FramesInfo::save(const QString& filePath,
+                      const std::pair<int, int>& frameRate,
+                      const QString& fingerprint,
+                      Encoding encoding) const
+{
+  QByteArray pts;
+  QByteArray hashes;
+  if (encoding == Raw)
+  {
+    pts = QByteArray::fromRawData(reinterpret_cast<const char*>(m_pts.data()), m_pts.size_bytes());
+    hashes = QByteArray::fromRawData(reinterpret_cast<const char*>(m_hashes.data()), m_hashes.size_bytes());
+  }
+  else
+  {
+    pts = encodePts(m_pts);
+    hashes = encodeHashes(m_hashes);
+  }
+
+  FramesFileHeader header;
+  std::memset(&header, 0, sizeof(FramesFileHeader));
+  std::memcpy(header.magic, frames_file_magic, sizeof(frames_file_magic));
+  header.version = frames_file_version;
+  header.header_size = sizeof(FramesFileHeader);
+  header.count = size();
+  header.frame_rate_num = frameRate.first;
+  header.frame_rate_den = frameRate.second;
+  const QByteArray fingerprint_bytes = fingerprint.toLatin1().left(sizeof(header.fingerprint));
+  std::memcpy(header.fingerprint, fingerprint_bytes.constData(), fingerprint_bytes.size());
+  header.encoding = encoding;
+  header.pts_offset = align_offset(sizeof(FramesFileHeader));
+  header.pts_size = pts.size();
+  header.hashes_offset = align_offset(header.pts_offset + header.pts_size);
+  header.hashes_size = hashes.size();
+  header.checksum = checksum(header,
+                             std::span(reinterpret_cast<const uchar*>(pts.constData()), pts.size()),
+                             std::span(reinterpret_cast<const uchar*>(hashes.constData()), hashes.size()));
+
+  QByteArray bytes(qsizetype(header.hashes_offset + header.hashes_size), '\0');
+  std::memcpy(bytes.data(), &header, sizeof(FramesFileHeader));
+  if (!empty())
+  {
+    std::memcpy(bytes.data() + header.pts_offset, pts.constData(), pts.size());
+    std::memcpy(bytes.data() + header.hashes_offset, hashes.constData(), hashes.size());
+  }
+
+  // the file may be mapped by another process, it must be replaced rather than truncated
+  QSaveFile file{filePath};
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit())
+  {
+    qDebug() << "could not write " << filePath;
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,70 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include "mediainfo.h"
+
+#include <QString>
+
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+class QFile;
+
+// The frames of a video and their perceptual hash, stored as a structure of arrays.
+// The arrays are either owned, or mapped from a file written by save() with
+// the raw encoding, so that they are loaded without being copied.
+class FramesInfo
+{
+public:
+  enum Encoding : quint32
+  {
+    // the arrays as in memory, which can be mapped
+    Raw = 0,
+    // the arrays encoded as by framecodec.h, several times smaller;
+    // they are decoded when loaded, so this is meant for archives
+    Packed = 1,
+  };
+
+  FramesInfo();
+  // The frames must be sorted by pts.
+  explicit FramesInfo(const std::vector<VideoFrameInfo>& frames);
+  FramesInfo(const FramesInfo&) = delete;
+  ~FramesInfo();
+
+  // Maps a file written by save(), and decodes it if it is packed;
+  // returns null if the file cannot be read,
+  // is of another version, is corrupt, or is not the one of the media
+  // with the given fingerprint (if not empty).
+  static std::unique_ptr<FramesInfo> load(const QString& filePath, const QString& fingerprint = QString());
+
+  bool save(const QString& filePath,
+            const std::pair<int, int>& frameRate,
+            const QString& fingerprint,
+            Encoding encoding) const;
+
+  bool empty() const { return m_pts.empty(); }
+  size_t size() const { return m_pts.size(); }
+
+  std::span<const int> pts() const { return m_pts; }
+  std::span<const quint64> hashes() const { return m_hashes; }
+  VideoFrameInfo at(size_t i) const { return VideoFrameInfo{.pts = m_pts[i], .phash = m_hashes[i]}; }
+
+  // Frame rate of the video the frames were extracted from,
+  // as written in the file; {0, 1} if the frames were not loaded from a file.
+  const std::pair<int, int>& frameRate() const { return m_frameRate; }
+
+  FramesInfo& operator=(const FramesInfo&) = delete;
+
+private:
+  std::vector<int> m_ownedPts;
+  std::vector<quint64> m_ownedHashes;
+  std::unique_ptr<QFile> m_file;
+  std::span<const int> m_pts;
+  std::span<const quint64> m_hashes;
+  std::pair<int, int> m_frameRate{0, 1};
+};
@@ -0,0 +1,420 @@
+#include "hamming.h"
+
+#include "fft.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAMMING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define HAMMING_X86 0
+#endif
+
+// GCC and Clang only let us use intrinsics in functions compiled for the
+// right target; MSVC accepts them anywhere.
+#if HAMMING_X86 && (defined(__GNUC__) || defined(__clang__))
+#define HAMMING_TARGET(x) __attribute__((target(x)))
+#else
+#define HAMMING_TARGET(x)
+#endif
+
+static void sliding_distances_scalar(const quint64* pattern,
+                                     size_t n,
+                                     const quint64* search,
+                                     size_t count,
+                                     int* distances)
+{
+  for (size_t i(0); i < count; ++i)
+  {
+    int dacc = 0;
+    for (size_t j(0); j < n; ++j)
+    {
+      dacc += std::popcount(pattern[j] ^ search[i + j]);
+    }
+    distances[i] = dacc;
+  }
+}
+
+#if HAMMING_X86
+
+namespace {
+
+struct CpuFeatures
+{
+  bool avx2 = false;
+  bool avx512 = false; // AVX-512F and VPOPCNTDQ
+};
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuidex(r, leaf, subleaf);
+  for (int i(0); i < 4; ++i)
+  {
+    regs[i] = static_cast<unsigned int>(r[i]);
+  }
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Returns the register state enabled by the OS.
+quint64 xgetbv0()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (quint64(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures detect_cpu_features()
+{
+  CpuFeatures result;
+
+  unsigned int regs[4];
+  cpuid(0, 0, regs);
+  const unsigned int max_leaf = regs[0];
+
+  if (max_leaf < 7)
+  {
+    return result;
+  }
+
+  cpuid(1, 0, regs);
+  const bool osxsave = regs[2] & (1u << 27);
+  const bool avx = regs[2] & (1u << 28);
+
+  if (!osxsave || !avx)
+  {
+    return result;
+  }
+
+  const quint64 xcr0 = xgetbv0();
+  const bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+  const bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+
+  cpuid(7, 0, regs);
+  result.avx2 = ymm_enabled && (regs[1] & (1u << 5));
+  result.avx512 = zmm_enabled && (regs[1] & (1u << 16)) && (regs[2] & (1u << 14));
+
+  return result;
+}
+
+const CpuFeatures& cpu_features()
+{
+  static const CpuFeatures features = detect_cpu_features();
+  return features;
+}
+
+} // namespace
+
+HAMMING_TARGET("avx2")
+static inline __m256i popcount_bytes_avx2(__m256i v)
+{
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i lo = _mm256_and_si256(v, low_mask);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+}
+
+HAMMING_TARGET("avx2")
+static inline void store_sums_avx2(__m256i sums, int* dest)
+{
+  // the sums fit in 32 bits, we keep the low half of each 64-bit lane
+  const __m256i indices = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  const __m256i packed = _mm256_permutevar8x32_epi32(sums, indices);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm256_castsi256_si128(packed));
+}
+
+// Computes 8 offsets at a time.
+// There is no popcount instruction for 64-bit lanes in AVX2: bits are counted per byte
+// using a nibble lookup table, and the byte counts are summed into the 64-bit lanes
+// every 31 hashes, before they can overflow.
+HAMMING_TARGET("avx2")
+static void sliding_distances_avx2(const quint64* pattern,
+                                   size_t n,
+                                   const quint64* search,
+                                   size_t count,
+                                   int* distances)
+{
+  const __m256i zero = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256i sums0 = zero;
+    __m256i sums1 = zero;
+
+    size_t j = 0;
+    while (j < n)
+    {
+      const size_t jend = std::min(n, j + 31);
+      __m256i bytes0 = zero;
+      __m256i bytes1 = zero;
+
+      for (; j < jend; ++j)
+      {
+        const __m256i p = _mm256_set1_epi64x(static_cast<long long>(pattern[j]));
+        const auto* s = reinterpret_cast<const __m256i*>(search + i + j);
+        bytes0 = _mm256_add_epi8(bytes0, popcount_bytes_avx2(_mm256_xor_si256(p, _mm256_loadu_si256(s))));
+        bytes1 = _mm256_add_epi8(bytes1, popcount_bytes_avx2(_mm256_xor_si256(p, _mm256_loadu_si256(s + 1))));
+      }
+
+      sums0 = _mm256_add_epi64(sums0, _mm256_sad_epu8(bytes0, zero));
+      sums1 = _mm256_add_epi64(sums1, _mm256_sad_epu8(bytes1, zero));
+    }
+
+    store_sums_avx2(sums0, distances + i);
+    store_sums_avx2(sums1, distances + i + 4);
+  }
+
+  sliding_distances_scalar(pattern, n, search + i, count - i, distances + i);
+}
+
+// Computes 16 offsets at a time using VPOPCNTQ.
+HAMMING_TARGET("avx512f,avx512vpopcntdq")
+static void sliding_distances_avx512(const quint64* pattern,
+                                     size_t n,
+                                     const quint64* search,
+                                     size_t count,
+                                     int* distances)
+{
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    __m512i sums0 = _mm512_setzero_si512();
+    __m512i sums1 = _mm512_setzero_si512();
+
+    for (size_t j(0); j < n; ++j)
+    {
+      const __m512i p = _mm512_set1_epi64(static_cast<long long>(pattern[j]));
+      const quint64* s = search + i + j;
+      sums0 = _mm512_add_epi64(sums0, _mm512_popcnt_epi64(_mm512_xor_si512(p, _mm512_loadu_si512(s))));
+      sums1 = _mm512_add_epi64(sums1, _mm512_popcnt_epi64(_mm512_xor_si512(p, _mm512_loadu_si512(s + 8))));
+    }
+
+    _mm512_mask_cvtepi64_storeu_epi32(distances + i, 0xff, sums0);
+    _mm512_mask_cvtepi64_storeu_epi32(distances + i + 8, 0xff, sums1);
+  }
+
+  sliding_distances_scalar(pattern, n, search + i, count - i, distances + i);
+}
+
+#endif // HAMMING_X86
+
+bool isHammingKernelSupported(HammingKernel kernel)
+{
+  switch (kernel)
+  {
+  case HammingKernel::Scalar:
+    return true;
+#if HAMMING_X86
+  case HammingKernel::AVX2:
+    return cpu_features().avx2;
+  case HammingKernel::AVX512:
+    return cpu_features().avx512;
+#endif
+  default:
+    return false;
+  }
+}
+
+static HammingKernel best_supported_kernel()
+{
+  for (HammingKernel k : {HammingKernel::AVX512, HammingKernel::AVX2})
+  {
+    if (isHammingKernelSupported(k))
+    {
+      return k;
+    }
+  }
+
+  return HammingKernel::Scalar;
+}
+
+static HammingKernel& selected_kernel()
+{
+  static HammingKernel kernel = best_supported_kernel();
+  return kernel;
+}
+
+HammingKernel hammingKernel()
+{
+  return selected_kernel();
+}
+
+void setHammingKernel(HammingKernel kernel)
+{
+  if (!isHammingKernelSupported(kernel))
+  {
+    kernel = HammingKernel::Scalar;
+  }
+
+  selected_kernel() = kernel;
+}
+
+const char* hammingKernelName(HammingKernel kernel)
+{
+  switch (kernel)
+  {
+  case HammingKernel::Scalar:
+    return "scalar";
+  case HammingKernel::AVX2:
+    return "avx2";
+  case HammingKernel::AVX512:
+    return "avx512";
+  default:
+    return "";
+  }
+}
+
+void slidingHammingDistances(const quint64* pattern,
+                             size_t n,
+                             const quint64* search,
+                             size_t count,
+                             int* distances)
+{
+  switch (hammingKernel())
+  {
+#if HAMMING_X86
+  case HammingKernel::AVX512:
+    sliding_distances_avx512(pattern, n, search, count, distances);
+    return;
+  case HammingKernel::AVX2:
+    sliding_distances_avx2(pattern, n, search, count, distances);
+    return;
+#endif
+  default:
+    sliding_distances_scalar(pattern, n, search, count, distances);
+    return;
+  }
+}
+
+bool hammingDistanceProfile(const quint64* pattern,
+                            size_t n,
+                            const quint64* search,
+                            size_t count,
+                            int* distances)
+{
+  if (count == 0)
+  {
+    return true;
+  }
+
+  const size_t m = count + n - 1;
+  const FFT fft{FFT::sizeFor(m)};
+  const size_t size = fft.size();
+
+  // With x and y the +1/-1 sequences of a bit, xor(a, b) = (1 - x * y) / 2,
+  // so the distance at offset i is (64 * n - sum of the correlations) / 2.
+  // Bits are processed by pairs: one in the real part, the other in the imaginary
+  // part; the real part of the correlation of the complex sequences is then the sum
+  // of the correlations of the two bits.
+  // Since the transform is linear, the products are accumulated over all pairs and
+  // a single inverse transform is needed.
+  std::vector<std::complex<double>> acc(size);
+  std::vector<std::complex<double>> p(size);
+  std::vector<std::complex<double>> s(size);
+
+  auto sign = [](quint64 hash, int bit) { return ((hash >> bit) & 1) ? -1.0 : 1.0; };
+
+  for (int bit = 0; bit < 64; bit += 2)
+  {
+    std::fill(p.begin(), p.end(), std::complex<double>());
+    for (size_t j(0); j < n; ++j)
+    {
+      p[j] = {sign(pattern[j], bit), sign(pattern[j], bit + 1)};
+    }
+
+    std::fill(s.begin(), s.end(), std::complex<double>());
+    for (size_t i(0); i < m; ++i)
+    {
+      s[i] = {sign(search[i], bit), sign(search[i], bit + 1)};
+    }
+
+    fft.forward(p.data());
+    fft.forward(s.data());
+
+    // acc += conj(p) * s
+    for (size_t k(0); k < size; ++k)
+    {
+      const std::complex<double> a = p[k];
+      const std::complex<double> b = s[k];
+      acc[k] += std::complex<double>(a.real() * b.real() + a.imag() * b.imag(),
+                                     a.real() * b.imag() - a.imag() * b.real());
+    }
+  }
+
+  fft.inverse(acc.data());
+
+  const qint64 nbits = 64 * qint64(n);
+
+  for (size_t i(0); i < count; ++i)
+  {
+    const double correlation = acc[i].real() / double(size);
+    const double rounded = std::round(correlation);
+
+    // the correlation is an integer with the parity of 64 * n,
+    // anything else means that the rounding errors are too large.
+    if (std::abs(correlation - rounded) > 0.25 || (nbits - qint64(rounded)) % 2 != 0)
+    {
+      return false;
+    }
+
+    distances[i] = int((nbits - qint64(rounded)) / 2);
+  }
+
+  return true;
+}
+
+// Cost model used to choose between the two methods.
+// Times are in nanoseconds and were measured with digidub-bench; only their
+// ratios matter.
+static double sliding_distances_cost(size_t n, size_t count)
+{
+  double ns_per_distance = 5;
+
+  switch (hammingKernel())
+  {
+  case HammingKernel::AVX512:
+    ns_per_distance = 0.1;
+    break;
+  case HammingKernel::AVX2:
+    ns_per_distance = 0.3;
+    break;
+  default:
+    break;
+  }
+
+  return double(n) * double(count) * ns_per_distance;
+}
+
+static double distance_profile_cost(size_t n, size_t count)
+{
+  // 65 transforms of (size / 2) * log2(size) butterflies; the time spent
+  // preparing the inputs is included in the cost of a butterfly.
+  const double size = double(FFT::sizeFor(count + n - 1));
+  constexpr double ns_per_butterfly = 6;
+  return 65 * (size / 2) * std::log2(size) * ns_per_butterfly;
+}
+
+bool isHammingDistanceProfileFaster(size_t n, size_t count)
+{
+  return distance_profile_cost(n, count) < sliding_distances_cost(n, count);
+}
@@ -0,0 +1,52 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef HAMMING_H
+#define HAMMING_H
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+enum class HammingKernel {
+  Scalar,
+  AVX2,
+  AVX512,
+};
+
+bool isHammingKernelSupported(HammingKernel kernel);
+
+// The kernel used by slidingHammingDistances().
+// Defaults to the fastest one supported by the cpu.
+HammingKernel hammingKernel();
+void setHammingKernel(HammingKernel kernel);
+
+const char* hammingKernelName(HammingKernel kernel);
+
+// Computes, for each offset i in [0, count), the sum of the hamming distances
+// between pattern[0..n) and search[i..i+n).
+// `search` must therefore hold at least count + n - 1 hashes.
+void slidingHammingDistances(const quint64* pattern,
+                             size_t n,
+                             const quint64* search,
+                             size_t count,
+                             int* distances);
+
+// Same as slidingHammingDistances(), but computes all the distances at once
+// in O((count + n) log(count + n)) using FFTs, which is faster for long patterns.
+// Each bit of the hashes is turned into a sequence of +1/-1, whose correlation
+// with the corresponding sequence of the pattern is computed in the frequency domain.
+// Returns false if floating-point errors prevent getting exact distances, in which
+// case the distances must be computed with slidingHammingDistances().
+bool hammingDistanceProfile(const quint64* pattern,
+                            size_t n,
+                            const quint64* search,
+                            size_t count,
+                            int* distances);
+
+// Returns whether hammingDistanceProfile() is expected to be faster than
+// slidingHammingDistances() with the current kernel.
+bool isHammingDistanceProfileFaster(size_t n, size_t count);
+
+#endif // HAMMING_H
@@ -0,0 +1,143 @@
+#include "hashindex.h"
+
+#include "matchalgo.h"
+#include "phash.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace MatchAlgo {
+
+static inline uint32_t substring(quint64 hash, int k)
+{
+  return uint32_t(hash >> (k * HashIndex::SubstringBits)) & 0xffff;
+}
+
+HashIndex::HashIndex(const quint64* hashes, size_t count)
+    : m_hashes(hashes)
+    , m_size(count)
+{
+  // counting sort of the frames by substring value; frames are visited in
+  // increasing order so that each bucket ends up sorted.
+  for (int k(0); k < NumberOfSubstrings; ++k)
+  {
+    Table& table = m_tables[k];
+    table.offsets.assign((size_t(1) << SubstringBits) + 1, 0);
+    table.frames.resize(count);
+
+    for (size_t i(0); i < count; ++i)
+    {
+      ++table.offsets[substring(hashes[i], k) + 1];
+    }
+
+    for (size_t v(1); v < table.offsets.size(); ++v)
+    {
+      table.offsets[v] += table.offsets[v - 1];
+    }
+
+    std::vector<uint32_t> next{table.offsets.begin(), table.offsets.end() - 1};
+    for (size_t i(0); i < count; ++i)
+    {
+      table.frames[next[substring(hashes[i], k)]++] = uint32_t(i);
+    }
+  }
+}
+
+HashIndex::HashIndex(const Video& video)
+    : HashIndex(video.hashes.data(), video.size())
+{}
+
+std::vector<size_t> HashIndex::find(quint64 hash, int radius) const
+{
+  std::vector<size_t> result;
+  find(hash, radius, 0, m_size, result);
+  return result;
+}
+
+void HashIndex::find(quint64 hash, int radius, size_t first, size_t last, std::vector<size_t>& result) const
+{
+  if (radius < 0 || first >= last)
+  {
+    return;
+  }
+
+  const size_t result_start = result.size();
+  const int subradius = std::min(radius / NumberOfSubstrings, SubstringBits);
+
+  // a frame is only reported by the first table in which it is within `subradius`
+  auto found_in_previous_tables = [&](quint64 other, int k) {
+    for (int l(0); l < k; ++l)
+    {
+      if (std::popcount(substring(hash ^ other, l)) <= subradius)
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (int k(0); k < NumberOfSubstrings; ++k)
+  {
+    const Table& table = m_tables[k];
+    const uint32_t key = substring(hash, k);
+
+    auto visit_bucket = [&](uint32_t value) {
+      auto begin = table.frames.begin() + table.offsets[value];
+      auto end = table.frames.begin() + table.offsets[value + 1];
+      auto it = std::lower_bound(begin, end, uint32_t(first));
+
+      for (; it != end && *it < last; ++it)
+      {
+        const quint64 other = m_hashes[*it];
+        if (phashDist(hash, other) <= radius && !found_in_previous_tables(other, k))
+        {
+          result.push_back(*it);
+        }
+      }
+    };
+
+    // enumerate the values within `subradius` of the key, by increasing
+    // number of flipped bits (Gosper's hack gives the next mask with the same popcount).
+    visit_bucket(key);
+    for (int d(1); d <= subradius; ++d)
+    {
+      uint32_t mask = (uint32_t(1) << d) - 1;
+      while (mask < (uint32_t(1) << SubstringBits))
+      {
+        visit_bucket(key ^ mask);
+
+        const uint32_t c = mask & (~mask + 1);
+        const uint32_t r = mask + c;
+        mask = (((r ^ mask) >> 2) / c) | r;
+      }
+    }
+  }
+
+  std::sort(result.begin() + result_start, result.end());
+}
+
+std::vector<std::pair<size_t, size_t>> find_similar_frames(const HashIndex& index,
+                                                           const FrameSpan& a,
+                                                           const FrameSpan& b,
+                                                           int radius,
+                                                           size_t step,
+                                                           size_t maxHits)
+{
+  std::vector<std::pair<size_t, size_t>> result;
+  std::vector<size_t> hits;
+  for (size_t i(0); i < a.size(); i += step)
+  {
+    hits.clear();
+    index.find(a.hash(i), radius, b.startOffset(), b.endOffset(), hits);
+    if (hits.size() <= maxHits)
+    {
+      for (size_t j : hits)
+      {
+        result.emplace_back(i, j - b.startOffset());
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace MatchAlgo
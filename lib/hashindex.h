@@ -0,0 +1,77 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace MatchAlgo {
+
+class FrameSpan;
+class Video;
+
+// Multi-index hashing table over the hashes of the frames of a video.
+// Each 64-bit hash is split into 4 substrings of 16 bits, each with its own table.
+// If two hashes are within distance r, one of their substrings is within r / 4,
+// so only the buckets close to the substrings of the query need to be visited.
+// This is much faster than a linear scan for small radii (up to about 12).
+class HashIndex
+{
+public:
+  // The hashes are not copied and must outlive the index.
+  HashIndex(const quint64* hashes, size_t count);
+  explicit HashIndex(const Video& video);
+
+  size_t size() const;
+
+  // Returns the frames whose hash is within `radius` of `hash`, in increasing order.
+  std::vector<size_t> find(quint64 hash, int radius) const;
+
+  // Same as above, but only considers frames in [first, last), and appends the
+  // frames to `result` instead of returning them.
+  void find(quint64 hash, int radius, size_t first, size_t last, std::vector<size_t>& result) const;
+
+  static constexpr int NumberOfSubstrings = 4;
+  static constexpr int SubstringBits = 16;
+
+private:
+  struct Table
+  {
+    // frames with substring value v are frames[offsets[v]..offsets[v+1]), in increasing order.
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> frames;
+  };
+
+private:
+  const quint64* m_hashes;
+  size_t m_size;
+  std::array<Table, NumberOfSubstrings> m_tables;
+};
+
+inline size_t HashIndex::size() const
+{
+  return m_size;
+}
+
+// Returns the pairs (i, j) of a frame i of `a` (one every `step` frames) and a frame j
+// of `b` whose hashes are within `radius`, relative to the spans and sorted by i then j.
+// `index` must be built over the video of `b`.
+// The frames of `a` that are similar to more than `maxHits` frames of `b` are too
+// ambiguous (e.g. black frames) and are skipped.
+std::vector<std::pair<size_t, size_t>> find_similar_frames(const HashIndex& index,
+                                                           const FrameSpan& a,
+                                                           const FrameSpan& b,
+                                                           int radius,
+                                                           size_t step,
+                                                           size_t maxHits);
+
+} // namespace MatchAlgo
+
+#endif // HASHINDEX_H
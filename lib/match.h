@@ -21,3 +21,12 @@ inline bool operator!=(const VideoMatch& lhs, const VideoMatch& rhs)
 {
   return !(lhs == rhs);
 }
+
+// A possible match for a scene of the first video, kept by the match detector
+// so that alternatives can be offered without running it again.
+struct MatchCandidate
+{
+  VideoMatch match;
+  double score = 0;    // average distance between the frames
+  int minDistance = 0; // lowest distance between two frames
+};
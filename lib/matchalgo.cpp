@@ -1,18 +1,27 @@
 #include "matchalgo.h"
 
+#include "alignment.h"
+#include "hamming.h"
+#include "hashindex.h"
+#include "matchtrace.h"
 #include "mediaobject.h"
+#include "parallel.h"
 #include "phash.h"
+#include "profiler.h"
+#include "timewarp.h"
 
 #include <QDebug>
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <optional>
 #include <type_traits>
 
-bool debugmatches = true;
-
 inline int get_nth_frame_pts(const MatchAlgo::Video& video, size_t n)
 {
-  return n < video.frames.size() ? video.frames.at(n).pts : (video.frames.back().pts + 1);
+  return n < video.size() ? video.pts[n] : (video.pts.back() + 1);
 }
 
 QString formatSeconds(double val)
@@ -45,28 +54,28 @@ QDebug operator<<(QDebug dbg, const MatchAlgo::FrameSpan& object)
 namespace MatchAlgo {
 
 template<typename Fun>
-void mark_frames(std::vector<Frame>& frames, double frameDelta, const TimeSegment& window, Fun&& fun)
+void mark_frames(const Video& video, const TimeSegment& window, Fun&& fun)
 {
   // TODO: use uint64_t instead?
-  auto get_frame_timestamp = [&](const Frame& frame) -> double { return frame.pts * frameDelta; };
+  auto get_frame_timestamp = [&video](int pts) -> double { return pts * video.frameDelta; };
 
-  auto within_window = [&get_frame_timestamp, window](const Frame& frame) {
-    const double t = get_frame_timestamp(frame);
+  auto within_window = [&get_frame_timestamp, window](int pts) {
+    const double t = get_frame_timestamp(pts);
     return window.contains(t * 1000);
   };
 
-  auto it = std::lower_bound(frames.begin(),
-                             frames.end(),
+  auto it = std::lower_bound(video.pts.begin(),
+                             video.pts.end(),
                              window.start() / double(1000),
-                             [&get_frame_timestamp](const Frame& e, double val) {
+                             [&get_frame_timestamp](int e, double val) {
                                return get_frame_timestamp(e) < val;
                              });
 
-  for (; it != frames.end(); ++it)
+  for (; it != video.pts.end(); ++it)
   {
     if (within_window(*it))
     {
-      fun(*it);
+      fun(size_t(std::distance(video.pts.begin(), it)));
     }
     else
     {
@@ -76,66 +85,60 @@ void mark_frames(std::vector<Frame>& frames, double frameDelta, const TimeSegmen
 }
 
 template<typename Fun>
-void mark_frames(std::vector<Frame>& frames,
-                 double frameDelta,
-                 const std::vector<TimeSegment>& windows,
-                 Fun&& fun)
+void mark_frames(const Video& video, const std::vector<TimeSegment>& windows, Fun&& fun)
 {
   for (const TimeSegment& w : windows)
   {
-    mark_frames(frames, frameDelta, w, std::forward<Fun>(fun));
+    mark_frames(video, w, std::forward<Fun>(fun));
   }
 }
 
 void mark_silence_frames(Video& video)
 {
-  auto mark_silence = [](Frame& frame) { frame.silence = true; };
-  mark_frames(video.frames, video.frameDelta, video.media->silenceInfo()->silences, mark_silence);
+  auto mark_silence = [&video](size_t i) { video.flags[i] |= SilenceFrame; };
+  mark_frames(video, video.media->silenceInfo()->silences, mark_silence);
 }
 
-void silenceborders(std::vector<Frame>& frames, size_t n = 10)
+void silenceborders(Video& video, size_t n = 10)
 {
-  auto silence_frame = [](Frame& f) { f.silence = true; };
+  std::vector<quint8>& flags = video.flags;
+  n = std::min(n, flags.size());
+
+  auto is_silence = [](quint8 f) { return (f & SilenceFrame) != 0; };
+  auto silence_frame = [](quint8& f) { f |= SilenceFrame; };
 
   // silence frames at the beginning if there is some silence nearby
   {
-    auto it = std::find_if(frames.begin(), frames.begin() + n, [](const Frame& f) {
-      return f.silence;
-    });
+    auto it = std::find_if(flags.begin(), flags.begin() + n, is_silence);
 
-    if (it != frames.begin() + n)
+    if (it != flags.begin() + n)
     {
-      std::for_each(frames.begin(), it, silence_frame);
+      std::for_each(flags.begin(), it, silence_frame);
     }
   }
 
   // silence frames at the end if there is some silence nearby
   {
-    auto it = std::find_if(frames.rbegin(), frames.rbegin() + n, [](const Frame& f) {
-      return f.silence;
-    });
+    auto it = std::find_if(flags.rbegin(), flags.rbegin() + n, is_silence);
 
-    if (it != frames.rbegin() + n)
+    if (it != flags.rbegin() + n)
     {
-      std::for_each(frames.rbegin(), it, silence_frame);
+      std::for_each(flags.rbegin(), it, silence_frame);
     }
   }
 }
 
 void mark_black_frames(Video& video)
 {
-  auto mark_black = [](Frame& frame) { frame.black = true; };
-  mark_frames(video.frames,
-              video.frameDelta,
-              video.media->blackFramesInfo()->blackframes,
-              mark_black);
+  auto mark_black = [&video](size_t i) { video.flags[i] |= BlackFrame; };
+  mark_frames(video, video.media->blackFramesInfo()->blackframes, mark_black);
 }
 
 void mark_sc_frames(Video& video, double threshold)
 {
-  Q_ASSERT(!video.frames.empty());
+  Q_ASSERT(video.size() > 0);
 
-  auto get_frame_timestamp = [&video](const Frame& frame) { return frame.pts * video.frameDelta; };
+  auto get_frame_timestamp = [&video](int pts) { return pts * video.frameDelta; };
 
   for (const SceneChange& e : video.media->scenesInfo()->scenechanges)
   {
@@ -144,25 +147,25 @@ void mark_sc_frames(Video& video, double threshold)
       continue;
     }
 
-    auto it = std::lower_bound(video.frames.begin(),
-                               video.frames.end(),
+    auto it = std::lower_bound(video.pts.begin(),
+                               video.pts.end(),
                                e.time,
-                               [&get_frame_timestamp](const Frame& e, double val) {
+                               [&get_frame_timestamp](int e, double val) {
                                  return get_frame_timestamp(e) < val;
                                });
 
-    if (it != video.frames.end())
+    if (it != video.pts.end())
     {
       const double t = get_frame_timestamp(*it);
 
-      if (!qFuzzyCompare(t, e.time) && it != video.frames.begin())
+      if (!qFuzzyCompare(t, e.time) && it != video.pts.begin())
       {
         --it;
       }
 
-      it->scscore = e.score;
+      video.scscores[std::distance(video.pts.begin(), it)] = e.score;
 
-      //qDebug() << "sc at frame pts = " << it->pts << "(score=" << e.score << ")";
+      //qDebug() << "sc at frame pts = " << *it << "(score=" << e.score << ")";
     }
   }
 
@@ -172,17 +175,17 @@ void mark_sc_frames(Video& video, double threshold)
 void merge_small_scenes(Video& video, size_t minSize)
 {
   auto find_next_scene =
-      [&video](std::vector<Frame>::iterator from) -> std::vector<Frame>::iterator {
-    if (from->scscore > 0)
+      [&video](std::vector<float>::iterator from) -> std::vector<float>::iterator {
+    if (*from > 0)
     {
       ++from;
     }
-    return std::find_if(from, video.frames.end(), [](const Frame& f) { return f.scscore > 0; });
+    return std::find_if(from, video.scscores.end(), [](float scscore) { return scscore > 0; });
   };
 
-  auto it = video.frames.begin();
+  auto it = video.scscores.begin();
 
-  while (it != video.frames.end())
+  while (it != video.scscores.end())
   {
     auto next = find_next_scene(it);
 
@@ -194,39 +197,29 @@ void merge_small_scenes(Video& video, size_t minSize)
       continue;
     }
 
-    if (next == video.frames.end())
+    if (next == video.scscores.end())
     {
-      it->scscore = 0;
+      *it = 0;
       it = next;
       break;
     }
 
-    if (next->scscore < it->scscore)
+    if (*next < *it)
     {
-      next->scscore = 0;
+      *next = 0;
     }
     else
     {
-      it->scscore = 0;
+      *it = 0;
       it = next;
     }
   }
 }
 
-inline int phashDist(const Frame& a, const Frame& b)
-{
-  return ::phashDist(a.phash, b.phash);
-}
-
-inline bool is_sc_frame(const Frame& frame)
-{
-  return frame.scscore > 0;
-}
-
 size_t find_silence_end(const FrameSpan& frames, size_t i)
 {
   //get out of silence if we are in one.
-  while (i < frames.size() && frames.at(i).silence)
+  while (i < frames.size() && frames.isSilence(i))
   {
     ++i;
   }
@@ -240,7 +233,7 @@ size_t find_next_silence(const FrameSpan& frames, size_t from = 0)
   size_t i = find_silence_end(frames, from);
 
   // then, go to next frame that is silence
-  while (i < frames.size() && !frames.at(i).silence)
+  while (i < frames.size() && !frames.isSilence(i))
   {
     ++i;
   }
@@ -254,7 +247,7 @@ size_t find_next_blackframe(const FrameSpan& frames, size_t from = 0)
 
   while (i < frames.size())
   {
-    if (frames.at(i).black)
+    if (frames.isBlack(i))
     {
       break;
     }
@@ -273,7 +266,7 @@ size_t find_next_scframe(const FrameSpan& frames, size_t from = 0)
 
   while (i < frames.size())
   {
-    if (is_sc_frame(frames.at(i)))
+    if (frames.isSceneChange(i))
     {
       break;
     }
@@ -344,7 +337,375 @@ struct MatchingArea
   double score;
 };
 
-MatchingArea find_best_matching_area_ex(const FrameSpan& pattern, const FrameSpan& searchArea)
+namespace {
+
+struct SearchCounters
+{
+  std::atomic<quint64> offsets{0};
+  std::atomic<quint64> offsetsSkipped{0};
+  std::atomic<quint64> offsetsAbandoned{0};
+  std::atomic<quint64> distances{0};
+  std::atomic<quint64> distancesPruned{0};
+  std::atomic<quint64> fftSearches{0};
+  std::atomic<quint64> pyramidSearches{0};
+};
+
+SearchCounters search_counters;
+
+void add_search_stats(const SearchStats& stats)
+{
+  search_counters.offsets += stats.offsets;
+  search_counters.offsetsSkipped += stats.offsetsSkipped;
+  search_counters.offsetsAbandoned += stats.offsetsAbandoned;
+  search_counters.distances += stats.distances;
+  search_counters.distancesPruned += stats.distancesPruned;
+  search_counters.fftSearches += stats.fftSearches;
+  search_counters.pyramidSearches += stats.pyramidSearches;
+}
+
+// The best offset of a search, and its summed distance.
+struct SearchResult
+{
+  size_t offset;
+  int distance;
+};
+
+// The best few offsets of a search, see Parameters::candidateMatches.
+// An offset closer to a better one than the size of the pattern is not kept,
+// since their areas mostly overlap. Offsets are added in increasing order,
+// so that ties go to the first one like for the best offset.
+class SearchCandidates
+{
+public:
+  SearchCandidates(size_t capacity, size_t patternSize)
+      : m_capacity(capacity)
+      , m_patternSize(patternSize)
+  {}
+
+  size_t capacity() const { return m_capacity; }
+
+  // Returns the distance an offset must get strictly below to be kept.
+  int threshold() const
+  {
+    if (m_results.size() < m_capacity)
+    {
+      return std::numeric_limits<int>::max();
+    }
+
+    return std::max_element(m_results.begin(), m_results.end(), is_better)->distance;
+  }
+
+  void add(size_t offset, int distance)
+  {
+    if (distance >= threshold())
+    {
+      return;
+    }
+
+    auto overlaps = [this, offset](const SearchResult& r) {
+      return (r.offset > offset ? r.offset - offset : offset - r.offset) < m_patternSize;
+    };
+
+    for (const SearchResult& r : m_results)
+    {
+      if (overlaps(r) && r.distance <= distance)
+      {
+        return;
+      }
+    }
+
+    std::erase_if(m_results, overlaps);
+    m_results.push_back(SearchResult{offset, distance});
+
+    if (m_results.size() > m_capacity)
+    {
+      m_results.erase(std::max_element(m_results.begin(), m_results.end(), is_better));
+    }
+  }
+
+  // Adds the candidates of a search whose offsets start at `first`.
+  void merge(const SearchCandidates& other, size_t first)
+  {
+    std::vector<SearchResult> results = other.m_results;
+    std::sort(results.begin(), results.end(), [](const SearchResult& lhs, const SearchResult& rhs) {
+      return lhs.offset < rhs.offset;
+    });
+
+    for (const SearchResult& r : results)
+    {
+      add(first + r.offset, r.distance);
+    }
+  }
+
+  // Returns the candidates, best first.
+  std::vector<SearchResult> results() const
+  {
+    std::vector<SearchResult> results = m_results;
+    std::sort(results.begin(), results.end(), is_better);
+    return results;
+  }
+
+private:
+  static bool is_better(const SearchResult& lhs, const SearchResult& rhs)
+  {
+    return std::pair(lhs.distance, lhs.offset) < std::pair(rhs.distance, rhs.offset);
+  }
+
+private:
+  size_t m_capacity;
+  size_t m_patternSize;
+  std::vector<SearchResult> m_results;
+};
+
+void search_exhaustive(const quint64* pattern,
+                       size_t n,
+                       const quint64* search,
+                       size_t nbOffsets,
+                       SearchResult& best,
+                       SearchStats& stats,
+                       SearchCandidates* candidates = nullptr)
+{
+  // the distances are computed by blocks of offsets with a vectorized kernel,
+  // offsets are then visited in order so that ties go to the first one.
+  constexpr size_t block_size = 256;
+  int distances[block_size];
+
+  for (size_t block(0); block < nbOffsets; block += block_size)
+  {
+    const size_t count = std::min(block_size, nbOffsets - block);
+    slidingHammingDistances(pattern, n, search + block, count, distances);
+
+    for (size_t k(0); k < count; ++k)
+    {
+      if (distances[k] < best.distance)
+      {
+        best.distance = distances[k];
+        best.offset = block + k;
+      }
+
+      if (candidates)
+      {
+        candidates->add(block + k, distances[k]);
+      }
+    }
+  }
+
+  stats.distances += nbOffsets * n;
+}
+
+// Same as search_exhaustive(), but all the distances are computed at once with FFTs.
+// Returns false if the distances could not be computed exactly.
+bool search_fft(const quint64* pattern,
+                size_t n,
+                const quint64* search,
+                size_t nbOffsets,
+                SearchResult& best,
+                SearchStats& stats,
+                SearchCandidates* candidates = nullptr)
+{
+  std::vector<int> distances(nbOffsets);
+  if (!hammingDistanceProfile(pattern, n, search, nbOffsets, distances.data()))
+  {
+    return false;
+  }
+
+  for (size_t i(0); i < nbOffsets; ++i)
+  {
+    if (distances[i] < best.distance)
+    {
+      best.distance = distances[i];
+      best.offset = i;
+    }
+
+    if (candidates)
+    {
+      candidates->add(i, distances[i]);
+    }
+  }
+
+  stats.fftSearches += 1;
+  return true;
+}
+
+// Same as search_exhaustive(), but offsets that cannot beat the best one
+// found so far are discarded as soon as possible.
+// Offsets are processed by small blocks and the pattern by chunks; after each chunk
+// we compute for each offset a lower bound of its distance: the partial sum
+// plus, for the frames not compared yet, the difference between the number of
+// bits set in the pattern and in the window (|popcount(a) - popcount(b)| <= popcount(a ^ b)).
+// The block is abandoned once no offset can get strictly below the best distance.
+// When the offsets are split across threads, `sharedBest` is the best distance found
+// by all of them; offsets that cannot get down to it are discarded too, while those
+// that tie with it are kept so that the first best offset still wins.
+// When `candidates` are kept, offsets are only discarded if they cannot be one of them.
+void search_pruned(const quint64* pattern,
+                   size_t n,
+                   const quint64* search,
+                   size_t nbOffsets,
+                   SearchResult& best,
+                   SearchStats& stats,
+                   std::atomic<int>* sharedBest = nullptr,
+                   SearchCandidates* candidates = nullptr)
+{
+  constexpr size_t block_size = 16;
+  constexpr size_t chunk_size = 32;
+
+  std::vector<int> pattern_bits(n + 1);
+  pattern_bits[0] = 0;
+  for (size_t j(0); j < n; ++j)
+  {
+    pattern_bits[j + 1] = pattern_bits[j] + std::popcount(pattern[j]);
+  }
+
+  std::vector<int> search_bits(nbOffsets + n);
+  search_bits[0] = 0;
+  for (size_t i(0); i + 1 < search_bits.size(); ++i)
+  {
+    search_bits[i + 1] = search_bits[i] + std::popcount(search[i]);
+  }
+
+  // lower bound of the distance of the frames [j, n) at offset i
+  auto bits_bound = [&](size_t i, size_t j) {
+    return std::abs((pattern_bits[n] - pattern_bits[j])
+                    - (search_bits[i + n] - search_bits[i + j]));
+  };
+
+  int sums[block_size];
+  int partial[block_size];
+
+  for (size_t block(0); block < nbOffsets; block += block_size)
+  {
+    const size_t count = std::min(block_size, nbOffsets - block);
+
+    auto hopeless = [&](size_t j) {
+      int threshold = candidates ? candidates->threshold() : best.distance;
+      if (sharedBest)
+      {
+        threshold = std::min(threshold, sharedBest->load(std::memory_order_relaxed) + 1);
+      }
+
+      for (size_t k(0); k < count; ++k)
+      {
+        if (sums[k] + bits_bound(block + k, j) < threshold)
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    std::fill_n(sums, count, 0);
+
+    if (hopeless(0))
+    {
+      stats.offsetsSkipped += count;
+      stats.distancesPruned += count * n;
+      continue;
+    }
+
+    size_t j = 0;
+    while (j < n)
+    {
+      const size_t len = std::min(chunk_size, n - j);
+      slidingHammingDistances(pattern + j, len, search + block + j, count, partial);
+      j += len;
+
+      for (size_t k(0); k < count; ++k)
+      {
+        sums[k] += partial[k];
+      }
+
+      if (j < n && hopeless(j))
+      {
+        break;
+      }
+    }
+
+    stats.distances += count * j;
+
+    if (j < n)
+    {
+      stats.offsetsAbandoned += count;
+      stats.distancesPruned += count * (n - j);
+      continue;
+    }
+
+    for (size_t k(0); k < count; ++k)
+    {
+      if (sums[k] < best.distance)
+      {
+        best.distance = sums[k];
+        best.offset = block + k;
+      }
+
+      if (candidates)
+      {
+        candidates->add(block + k, sums[k]);
+      }
+    }
+
+    if (sharedBest)
+    {
+      int current = sharedBest->load(std::memory_order_relaxed);
+      while (best.distance < current
+             && !sharedBest->compare_exchange_weak(current, best.distance, std::memory_order_relaxed))
+      {
+      }
+    }
+  }
+}
+
+} // namespace
+
+SearchStats searchStats()
+{
+  SearchStats result;
+  result.offsets = search_counters.offsets;
+  result.offsetsSkipped = search_counters.offsetsSkipped;
+  result.offsetsAbandoned = search_counters.offsetsAbandoned;
+  result.distances = search_counters.distances;
+  result.distancesPruned = search_counters.distancesPruned;
+  result.fftSearches = search_counters.fftSearches;
+  result.pyramidSearches = search_counters.pyramidSearches;
+  return result;
+}
+
+void resetSearchStats()
+{
+  search_counters.offsets = 0;
+  search_counters.offsetsSkipped = 0;
+  search_counters.offsetsAbandoned = 0;
+  search_counters.distances = 0;
+  search_counters.distancesPruned = 0;
+  search_counters.fftSearches = 0;
+  search_counters.pyramidSearches = 0;
+}
+
+// Returns the number of chunks of offsets in which a search should be split,
+// to be searched concurrently.
+// Searches of less than a few million frame distances stay on the calling thread;
+// there are a few chunks per thread, since pruning makes their cost uneven.
+static size_t number_of_search_chunks(size_t n, size_t nbOffsets, const Parameters& algoParams)
+{
+  constexpr size_t min_work = size_t(1) << 22;
+  constexpr size_t min_chunk_work = min_work / 4;
+
+  const size_t work = n * nbOffsets;
+
+  if (!algoParams.parallelSearch || work < min_work || maxParallelThreads() <= 1)
+  {
+    return 1;
+  }
+
+  return std::min({size_t(maxParallelThreads()) * 4, work / min_chunk_work, nbOffsets / 64});
+}
+
+// Searches every offset of the search area.
+// The best offsets are also added to the candidates, if any.
+static MatchingArea search_all_offsets(const FrameSpan& pattern,
+                                       const FrameSpan& searchArea,
+                                       const Parameters& algoParams,
+                                       SearchCandidates* candidates = nullptr)
 {
   MatchingArea result;
   result.score = 64;
@@ -358,44 +719,454 @@ MatchingArea find_best_matching_area_ex(const FrameSpan& pattern, const FrameSpa
 
   // TODO: we could define "best" not only in terms of average,
   // but also in terms of number of phash-dist less than a given value.
-  double bestavg = 64;
 
-  size_t imax = searchArea.size() - pattern.size();
-  for (size_t i(0); i <= imax; ++i)
+  const size_t n = pattern.size();
+  const size_t nb_offsets = searchArea.size() - n + 1;
+
+  // an offset is better if its average distance is strictly lower,
+  // which is the same as comparing the sums.
+  SearchResult best;
+  best.offset = nb_offsets;
+  best.distance = 64 * int(n);
+
+  SearchStats stats;
+  stats.offsets = nb_offsets;
+
+  // the offsets of the candidates are relative to the search area until the end
+  SearchCandidates area_candidates{candidates ? candidates->capacity() : 0, n};
+  SearchCandidates* const kept = candidates ? &area_candidates : nullptr;
+
+  const bool use_fft = algoParams.fftSearch && isHammingDistanceProfileFaster(n, nb_offsets);
+
+  if (!use_fft || !search_fft(pattern.hashes(), n, searchArea.hashes(), nb_offsets, best, stats, kept))
+  {
+    // pruning only pays off if there is enough work to skip
+    const bool use_pruning = algoParams.pruneSearch && n >= 32 && nb_offsets > 16;
+
+    // best distance of all the chunks of a parallel search, for pruning;
+    // not shared when keeping candidates, as each chunk may have some of them
+    std::atomic<int> shared_best{best.distance};
+
+    auto search = [&](size_t first,
+                      size_t count,
+                      SearchResult& result,
+                      SearchStats& resultStats,
+                      SearchCandidates* resultCandidates) {
+      if (use_pruning)
+      {
+        search_pruned(pattern.hashes(),
+                      n,
+                      searchArea.hashes() + first,
+                      count,
+                      result,
+                      resultStats,
+                      resultCandidates ? nullptr : &shared_best,
+                      resultCandidates);
+      }
+      else
+      {
+        search_exhaustive(pattern.hashes(),
+                          n,
+                          searchArea.hashes() + first,
+                          count,
+                          result,
+                          resultStats,
+                          resultCandidates);
+      }
+    };
+
+    const size_t nb_chunks = number_of_search_chunks(n, nb_offsets, algoParams);
+
+    if (nb_chunks <= 1)
+    {
+      search(0, nb_offsets, best, stats, kept);
+    }
+    else
+    {
+      // the chunks are searched independently, their results are then
+      // reduced in order so that the first best offset still wins.
+      const size_t chunk_size = (nb_offsets + nb_chunks - 1) / nb_chunks;
+      std::vector<SearchResult> chunk_results(nb_chunks, best);
+      std::vector<SearchStats> chunk_stats(nb_chunks);
+      std::vector<SearchCandidates> chunk_candidates(nb_chunks, area_candidates);
+
+      parallelFor(nb_chunks, [&](size_t c) {
+        const size_t first = c * chunk_size;
+        search(first,
+               std::min(chunk_size, nb_offsets - first),
+               chunk_results[c],
+               chunk_stats[c],
+               kept ? &chunk_candidates[c] : nullptr);
+        chunk_results[c].offset += first;
+      });
+
+      for (size_t c(0); c < nb_chunks; ++c)
+      {
+        if (chunk_results[c].distance < best.distance)
+        {
+          best = chunk_results[c];
+        }
+
+        add_search_stats(chunk_stats[c]);
+
+        if (kept)
+        {
+          kept->merge(chunk_candidates[c], c * chunk_size);
+        }
+      }
+    }
+  }
+
+  if (candidates)
+  {
+    candidates->merge(area_candidates, searchArea.startOffset());
+  }
+
+  add_search_stats(stats);
+
+  if (best.offset != nb_offsets)
+  {
+    result.match = searchArea.subspan(best.offset, n);
+    result.score = best.distance / double(n);
+  }
+
+  return result;
+}
+
+// Searches the start offsets in the given ranges, which are inclusive,
+// in increasing order and within the search area.
+// Since the ranges are searched in order, the first best offset wins like
+// in a search of the whole area.
+static MatchingArea search_offset_ranges(const FrameSpan& pattern,
+                                         const FrameSpan& searchArea,
+                                         const std::vector<std::pair<size_t, size_t>>& ranges,
+                                         const Parameters& algoParams,
+                                         SearchCandidates* candidates = nullptr)
+{
+  MatchingArea result;
+  result.score = 64;
+  result.pattern = pattern;
+  result.match = FrameSpan(*searchArea.video, searchArea.first + searchArea.count, 0);
+
+  for (const auto& [lo, hi] : ranges)
+  {
+    const FrameSpan area{*searchArea.video, lo, hi - lo + pattern.size()};
+    MatchingArea m = search_all_offsets(pattern, area, algoParams, candidates);
+
+    if (m.match.size() > 0 && m.score < result.score)
+    {
+      result = m;
+    }
+  }
+
+  return result;
+}
+
+// Returns the level of the temporal pyramid at which a search should start,
+// or 0 if it should be done at full resolution.
+// The sampled pattern must remain long enough to be discriminating, and there
+// must be enough offsets for the refinement at full resolution to be negligible.
+static int pyramid_level_for(const Video& video, size_t n, size_t nbOffsets)
+{
+  int level = 0;
+  size_t factor = Video::PyramidFactor;
+
+  while (level < video.pyramidLevels() && n / factor >= 8 && nbOffsets / factor >= 64)
+  {
+    ++level;
+    factor *= Video::PyramidFactor;
+  }
+
+  return level;
+}
+
+// Searches the offsets that are a multiple of 4^level using the temporal pyramid
+// of the search area's video and a pattern sampled at the same rate, then searches
+// at full resolution around the best few of them.
+// Hashes change slowly within a scene, so the best offset is very likely next to
+// one of these candidates.
+static MatchingArea search_pyramid(const FrameSpan& pattern,
+                                   const FrameSpan& searchArea,
+                                   int level,
+                                   const Parameters& algoParams,
+                                   SearchCandidates* candidates = nullptr)
+{
+  constexpr size_t nb_candidates = 8;
+
+  const Video& video = *searchArea.video;
+  const HashVector& coarse_hashes = video.pyramidLevel(level);
+
+  size_t factor = 1;
+  for (int i(0); i < level; ++i)
+  {
+    factor *= Video::PyramidFactor;
+  }
+
+  const size_t n = pattern.size();
+  std::vector<quint64> samples;
+  for (size_t i(0); i < n; i += factor)
+  {
+    samples.push_back(pattern.hash(i));
+  }
+
+  const size_t first_offset = searchArea.startOffset();
+  const size_t last_offset = searchArea.endOffset() - n;
+  const size_t first_coarse_offset = (first_offset + factor - 1) / factor;
+  const size_t last_coarse_offset = last_offset / factor;
+
+  if (first_coarse_offset > last_coarse_offset)
+  {
+    return search_all_offsets(pattern, searchArea, algoParams, candidates);
+  }
+
+  // the last sample of the last offset is at most at frame last_offset + n - 1,
+  // so it is within the level.
+  const size_t nb_coarse_offsets = last_coarse_offset - first_coarse_offset + 1;
+  std::vector<int> distances(nb_coarse_offsets);
+  slidingHammingDistances(samples.data(),
+                          samples.size(),
+                          coarse_hashes.data() + first_coarse_offset,
+                          nb_coarse_offsets,
+                          distances.data());
+
+  SearchStats stats;
+  stats.distances = nb_coarse_offsets * samples.size();
+  stats.pyramidSearches = 1;
+  add_search_stats(stats);
+
+  std::vector<size_t> coarse_candidates(nb_coarse_offsets);
+  std::iota(coarse_candidates.begin(), coarse_candidates.end(), size_t(0));
+  const size_t nb_kept = std::min(nb_candidates, coarse_candidates.size());
+  std::partial_sort(coarse_candidates.begin(),
+                    coarse_candidates.begin() + nb_kept,
+                    coarse_candidates.end(),
+                    [&distances](size_t lhs, size_t rhs) {
+                      return std::pair(distances[lhs], lhs) < std::pair(distances[rhs], rhs);
+                    });
+  coarse_candidates.resize(nb_kept);
+  std::sort(coarse_candidates.begin(), coarse_candidates.end());
+
+  // the best offset is searched up to factor - 1 frames around each candidate
+  std::vector<std::pair<size_t, size_t>> ranges;
+  for (size_t c : coarse_candidates)
+  {
+    const size_t offset = (first_coarse_offset + c) * factor;
+    const size_t lo = std::max(offset - std::min(offset, factor - 1), first_offset);
+    const size_t hi = std::min(offset + factor - 1, last_offset);
+
+    if (!ranges.empty() && lo <= ranges.back().second + 1)
+    {
+      ranges.back().second = std::max(ranges.back().second, hi);
+    }
+    else
+    {
+      ranges.emplace_back(lo, hi);
+    }
+  }
+
+  return search_offset_ranges(pattern, searchArea, ranges, algoParams, candidates);
+}
+
+// Returns the best matching area of the pattern in the search area; the best
+// offsets that were searched are also added to the candidates, if any.
+MatchingArea find_best_matching_area_ex(const FrameSpan& pattern,
+                                        const FrameSpan& searchArea,
+                                        const Parameters& algoParams,
+                                        SearchCandidates* candidates = nullptr)
+{
+  if (algoParams.pyramidSearch && searchArea.size() >= pattern.size())
+  {
+    const size_t nb_offsets = searchArea.size() - pattern.size() + 1;
+    const int level = pyramid_level_for(*searchArea.video, pattern.size(), nb_offsets);
+
+    if (level > 0)
+    {
+      return search_pyramid(pattern, searchArea, level, algoParams, candidates);
+    }
+  }
+
+  return search_all_offsets(pattern, searchArea, algoParams, candidates);
+}
+
+// Same as find_best_matching_area_ex(), but only searches the offsets suggested
+// by the seeds of the pattern, i.e. its frames having nearly identical frames in the
+// search area. Collinear seeds are chained, allowing for a speed ratio of 0.95 to 1.05.
+// Falls back to find_best_matching_area_ex() if the pattern has no usable seed frames.
+MatchingArea find_best_matching_area_seeded(const FrameSpan& pattern,
+                                            const FrameSpan& searchArea,
+                                            const HashIndex& index,
+                                            const Parameters& algoParams,
+                                            SearchCandidates* candidates = nullptr)
+{
+  // frames of a scene are very similar, so a few of them are enough
+  constexpr size_t max_seed_frames = 32;
+  // frames found in more places than this are not discriminating (e.g. black or title frames)
+  constexpr size_t max_runs_per_seed = 16;
+  // number of chains (with the most seeds) that are searched
+  constexpr size_t max_chains = 8;
+
+  MatchingArea result;
+  result.score = 64;
+  result.pattern = pattern;
+  result.match = FrameSpan(*searchArea.video, searchArea.first + searchArea.count, 0);
+
+  if (searchArea.size() < pattern.size())
+  {
+    return result;
+  }
+
+  const size_t n = pattern.size();
+
+  // a 5% speed difference moves the seeds by up to n / 20 frames from the start offset
+  const ptrdiff_t tolerance = std::max<size_t>(n / 20, 3);
+
+  // a seed is a run of consecutive matching frames in the search area, which gives
+  // a range of offsets at which the pattern could start in the second video.
+  struct Seed
+  {
+    ptrdiff_t first;
+    ptrdiff_t last;
+  };
+
+  std::vector<Seed> seeds;
+  std::vector<Seed> runs;
+  std::vector<size_t> hits;
+  bool has_seed_frames = false;
+
+  const size_t step = std::max<size_t>(n / max_seed_frames, 1);
+  for (size_t i(0); i < n; i += step)
+  {
+    if (pattern.isBlack(i))
+    {
+      continue;
+    }
+
+    hits.clear();
+    index.find(pattern.hash(i),
+               algoParams.seedRadius,
+               searchArea.startOffset(),
+               searchArea.endOffset(),
+               hits);
+
+    runs.clear();
+    for (size_t j : hits)
+    {
+      const ptrdiff_t d = ptrdiff_t(j) - ptrdiff_t(i);
+      if (!runs.empty() && d - runs.back().last <= tolerance)
+      {
+        runs.back().last = d;
+      }
+      else
+      {
+        runs.push_back(Seed{d, d});
+      }
+    }
+
+    if (runs.size() > max_runs_per_seed)
+    {
+      continue;
+    }
+
+    has_seed_frames = true;
+    seeds.insert(seeds.end(), runs.begin(), runs.end());
+  }
+
+  if (!has_seed_frames)
+  {
+    return find_best_matching_area_ex(pattern, searchArea, algoParams, candidates);
+  }
+
+  struct Chain
   {
-    int dacc = 0;
-    int dmin = 64;
-    for (size_t j(0); j < pattern.size(); ++j)
+    ptrdiff_t first;
+    ptrdiff_t last;
+    size_t seeds;
+  };
+
+  std::sort(seeds.begin(), seeds.end(), [](const Seed& lhs, const Seed& rhs) {
+    return lhs.first < rhs.first;
+  });
+
+  std::vector<Chain> chains;
+  for (const Seed& seed : seeds)
+  {
+    if (!chains.empty() && seed.first - chains.back().last <= tolerance)
     {
-      int d = phashDist(pattern.at(j), searchArea.at(i + j));
-      dacc += d;
-      dmin = std::min(d, dmin);
+      chains.back().last = std::max(chains.back().last, seed.last);
+      ++chains.back().seeds;
     }
+    else
+    {
+      chains.push_back(Chain{seed.first, seed.last, 1});
+    }
+  }
+
+  if (chains.size() > max_chains)
+  {
+    std::stable_sort(chains.begin(), chains.end(), [](const Chain& lhs, const Chain& rhs) {
+      return lhs.seeds > rhs.seeds;
+    });
+    chains.resize(max_chains);
+    std::sort(chains.begin(), chains.end(), [](const Chain& lhs, const Chain& rhs) {
+      return lhs.first < rhs.first;
+    });
+  }
 
-    double avg = dacc / double(pattern.size());
+  // each chain gives a range of offsets, overlapping ranges are merged
+  const ptrdiff_t first_offset = searchArea.startOffset();
+  const ptrdiff_t last_offset = searchArea.endOffset() - n;
+  std::vector<std::pair<size_t, size_t>> ranges;
 
-    // TODO: should this be kept?
-    // maybe... but 4 is too harsh
-    // if (dmin >= 4)
-    // {
-    //   continue;
-    // }
+  for (const Chain& chain : chains)
+  {
+    const ptrdiff_t lo = std::max(chain.first - tolerance, first_offset);
+    const ptrdiff_t hi = std::min(chain.last + tolerance, last_offset);
 
-    if (avg < bestavg)
+    if (lo > hi)
     {
-      bestavg = avg;
-      result.match = searchArea.subspan(i, pattern.size());
-      result.score = avg;
+      continue;
     }
+
+    if (!ranges.empty() && size_t(lo) <= ranges.back().second + 1)
+    {
+      ranges.back().second = std::max(ranges.back().second, size_t(hi));
+    }
+    else
+    {
+      ranges.emplace_back(lo, hi);
+    }
+  }
+
+  return search_offset_ranges(pattern, searchArea, ranges, algoParams, candidates);
+}
+
+// Returns the matching areas of the candidates of a search of the pattern, best first.
+static std::vector<MatchingArea> candidate_areas(const SearchCandidates& candidates,
+                                                 const FrameSpan& pattern,
+                                                 const Video& video)
+{
+  std::vector<MatchingArea> result;
+
+  for (const SearchResult& candidate : candidates.results())
+  {
+    MatchingArea& area = result.emplace_back();
+    area.pattern = pattern;
+    area.match = FrameSpan(video, candidate.offset, pattern.size());
+    area.score = candidate.distance / double(pattern.size());
   }
 
   return result;
 }
 
-FrameSpan find_best_matching_area(const FrameSpan& pattern, const FrameSpan& searchArea)
+FrameSpan find_best_matching_area(const FrameSpan& pattern,
+                                  const FrameSpan& searchArea,
+                                  const Parameters& algoParams)
 {
-  auto result = find_best_matching_area_ex(pattern, searchArea);
-  qDebug() << result.score << result.pattern << result.match;
+  auto result = find_best_matching_area_ex(pattern, searchArea, algoParams);
+  MATCH_TRACE(Searches, "search")
+      .field("pattern", result.pattern)
+      .field("match", result.match)
+      .field("score", result.score);
   return result.match;
 }
 
@@ -426,12 +1197,15 @@ inline FrameSpan merge(FrameSpan a, FrameSpan b)
   return FrameSpan{*a.video, a.startOffset(), b.endOffset() - a.startOffset()};
 }
 
+// The best areas found for each scene the match is extended to are added
+// to the candidates, if any.
 std::pair<std::vector<FrameSpan>::const_iterator, FrameSpan> extend_match(
     MatchingArea matchStart,
     std::vector<FrameSpan>::const_iterator ikframes_begin,
     std::vector<FrameSpan>::const_iterator ikframes_end,
     size_t searchAreaEnd,
-    const Parameters& algoParams)
+    const Parameters& algoParams,
+    std::vector<MatchingArea>* candidates = nullptr)
 {
   std::pair<FrameSpan, FrameSpan> prev_match{matchStart.pattern, matchStart.match};
 
@@ -461,13 +1235,27 @@ std::pair<std::vector<FrameSpan>::const_iterator, FrameSpan> extend_match(
     }
 
     // then we try to find a match:
-    MatchingArea m = find_best_matching_area_ex(current_pattern, search_area);
+    SearchCandidates scene_candidates{size_t(std::max(algoParams.candidateMatches, 0)),
+                                      current_pattern.size()};
+    MatchingArea m = find_best_matching_area_ex(current_pattern,
+                                                search_area,
+                                                algoParams,
+                                                candidates ? &scene_candidates : nullptr);
 
     if (m.score > algoParams.areaMatchThreshold) // no good match, stop here
     {
       break;
     }
 
+    if (candidates)
+    {
+      for (const MatchingArea& candidate :
+           candidate_areas(scene_candidates, current_pattern, *search_area.video))
+      {
+        candidates->push_back(candidate);
+      }
+    }
+
     // we try to refine the match by searching for a match that includes the previous segment.
     // this helps avoiding getting too far ahead.
     if (m.match.startOffset() != prev_match.second.endOffset())
@@ -480,6 +1268,9 @@ std::pair<std::vector<FrameSpan>::const_iterator, FrameSpan> extend_match(
         size_t diff = prev_match.second.endOffset() - m.match.startOffset();
         match_concat.widenLeft(diff);
         match_concat.count += diff;
+        // don't go past the end of the video
+        match_concat.count = std::min(match_concat.count,
+                                      match_concat.video->size() - match_concat.first);
       }
 
       FrameSpan pattern_concat = *it;
@@ -502,7 +1293,9 @@ std::pair<std::vector<FrameSpan>::const_iterator, FrameSpan> extend_match(
         pattern_concat = merge(pattern_concat, *it);
       }
 
-      MatchingArea refined_match = find_best_matching_area_ex(pattern_concat, match_concat);
+      MatchingArea refined_match = find_best_matching_area_ex(pattern_concat,
+                                                              match_concat,
+                                                              algoParams);
       refined_match.match.trimLeft(number_of_frames_from_prev_pattern);
       refined_match.match.count += number_of_frames_removed_from_cur_pattern;
       assert(refined_match.match.count == m.match.count);
@@ -546,7 +1339,7 @@ bool starts_with_black_frames(const FrameSpan& span)
     return false;
   }
 
-  if (span.at(0).black)
+  if (span.isBlack(0))
   {
     return true;
   }
@@ -555,7 +1348,7 @@ bool starts_with_black_frames(const FrameSpan& span)
 
   if (span.startOffset() > 0)
   {
-    if (video.frames.at(span.startOffset() - 1).black)
+    if (video.isBlack(span.startOffset() - 1))
     {
       return true;
     }
@@ -571,16 +1364,16 @@ bool ends_with_black_frames(const FrameSpan& span)
     return false;
   }
 
-  if (span.at(span.size() - 1).black)
+  if (span.isBlack(span.size() - 1))
   {
     return true;
   }
 
   const Video& video = *span.video;
 
-  if (span.endOffset() < video.frames.size())
+  if (span.endOffset() < video.size())
   {
-    if (video.frames.at(span.endOffset()).black)
+    if (video.isBlack(span.endOffset()))
     {
       return true;
     }
@@ -589,14 +1382,14 @@ bool ends_with_black_frames(const FrameSpan& span)
   return false;
 }
 
-bool likely_same_scene(FrameSpan a, FrameSpan b, double areaMatchThreshold)
+bool likely_same_scene(FrameSpan a, FrameSpan b, const Parameters& algoParams)
 {
   if (b.size() < a.size())
   {
     std::swap(a, b);
   }
 
-  return find_best_matching_area_ex(a, b).score <= areaMatchThreshold;
+  return find_best_matching_area_ex(a, b, algoParams).score <= algoParams.areaMatchThreshold;
 }
 
 size_t number_of_frames_in_range(std::vector<FrameSpan>::const_iterator begin,
@@ -621,7 +1414,7 @@ std::optional<std::pair<size_t, size_t>> find_best_match(const FrameSpan& a,
   {
     for (size_t y(0); y < b.size(); ++y)
     {
-      int d = phashDist(a.at(x), b.at(y));
+      int d = phashDist(a.hash(x), b.hash(y));
       if (d < bestd)
       {
         bestd = d;
@@ -664,7 +1457,7 @@ std::pair<size_t, size_t> find_match_end(const Video& a,
   {
     size_t next_frame_a = i + 1;
     size_t next_frame_b = std::round(jreal + speed);
-    const int diff = phashDist(a.frames.at(next_frame_a), b.frames.at(next_frame_b));
+    const int diff = phashDist(a.hashes[next_frame_a], b.hashes[next_frame_b]);
 
     if (diff < algoParams.frameUnmatchThreshold)
     {
@@ -696,7 +1489,7 @@ std::pair<size_t, size_t> find_match_end(const Video& a,
   {
     // we are just missing one frame from video A.
     // let's see if we can include it in the match
-    const int diff = phashDist(a.frames.at(i + 1), b.frames.at(j));
+    const int diff = phashDist(a.hashes[i + 1], b.hashes[j]);
     if (diff < algoParams.frameUnmatchThreshold)
     {
       ++i;
@@ -722,7 +1515,7 @@ std::pair<size_t, size_t> find_match_end_backward(const Video& a,
     size_t prev_frame_a = i - 1;
     size_t prev_frame_b = std::round(jreal - speed);
 
-    const int diff = phashDist(a.frames.at(prev_frame_a), b.frames.at(prev_frame_b));
+    const int diff = phashDist(a.hashes[prev_frame_a], b.hashes[prev_frame_b]);
 
     if (diff < algoParams.frameUnmatchThreshold)
     {
@@ -754,7 +1547,7 @@ std::pair<size_t, size_t> find_match_end_backward(const Video& a,
   {
     // we are just missing one frame from video A.
     // let's see if we can include it in the match
-    const int diff = phashDist(a.frames.at(i_min), b.frames.at(j));
+    const int diff = phashDist(a.hashes[i_min], b.hashes[j]);
     if (diff < algoParams.frameUnmatchThreshold)
     {
       i = i_min;
@@ -781,7 +1574,9 @@ std::pair<FrameSpan, FrameSpan> refine_match_2scenes(std::vector<FrameSpan>::con
 
   assert(basematch.size() >= first_to_second_scene_transition.size());
 
-  MatchingArea local_match = find_best_matching_area_ex(first_to_second_scene_transition, basematch);
+  MatchingArea local_match = find_best_matching_area_ex(first_to_second_scene_transition,
+                                                        basematch,
+                                                        algoParams);
 
   size_t vid1_sc = local_match.pattern.startOffset() + local_match.pattern.size() / 2;
   size_t vid2_sc = local_match.match.startOffset() + local_match.match.size() / 2;
@@ -814,7 +1609,7 @@ std::pair<FrameSpan, FrameSpan> refine_match_2scenes(std::vector<FrameSpan>::con
     std::vector<FrameSpan> scenes_vid2 = split_at_scframes(search_span);
     for (const FrameSpan& span : scenes_vid2)
     {
-      if (likely_same_scene(*std::next(it), span, algoParams.areaMatchThreshold))
+      if (likely_same_scene(*std::next(it), span, algoParams))
       {
         refined_match.moveEndOffset(span.endOffset());
       }
@@ -852,7 +1647,7 @@ std::pair<FrameSpan, FrameSpan> refine_match_2scenes(std::vector<FrameSpan>::con
     std::reverse(scenes_vid2.begin(), scenes_vid2.end());
     for (const FrameSpan& span : scenes_vid2)
     {
-      if (likely_same_scene(*std::next(it), span, algoParams.areaMatchThreshold))
+      if (likely_same_scene(*std::next(it), span, algoParams))
       {
         refined_match.moveStartOffsetTo(span.startOffset());
       }
@@ -951,7 +1746,8 @@ std::pair<FrameSpan, FrameSpan> refine_match(std::vector<FrameSpan>::const_itera
     const size_t search_area_size = number_of_frames_in_range(begin, std::next(begin, 3));
 
     MatchingArea local_match = find_best_matching_area_ex(first_to_second_scene_transition,
-                                                          basematch.left(search_area_size));
+                                                          basematch.left(search_area_size),
+                                                          algoParams);
 
     if (local_match.score > algoParams.areaMatchThreshold)
     {
@@ -972,7 +1768,8 @@ std::pair<FrameSpan, FrameSpan> refine_match(std::vector<FrameSpan>::const_itera
         compute_symetric_span_around_keyframe(*std::prev(end, 2), *std::prev(end), 5);
     const size_t search_area_size = number_of_frames_in_range(std::prev(end, 3), end);
     MatchingArea local_match = find_best_matching_area_ex(penultimate_to_last_scene_transition,
-                                                          basematch.right(search_area_size));
+                                                          basematch.right(search_area_size),
+                                                          algoParams);
     if (local_match.score > algoParams.areaMatchThreshold)
     {
       // happens in S1E46
@@ -1057,29 +1854,40 @@ static bool append_match(std::vector<FrameSpanMatch>& list, FrameSpanMatch m)
   return true;
 }
 
-static std::vector<FrameSpanMatch> find_matches_in_segment(const FrameSpan& segment,
-                                                           const FrameSpan& searchArea,
-                                                           const Parameters& algoParams)
+struct SegmentMatches
 {
-  if (debugmatches)
-  {
-    qDebug() << "S:" << segment << " A:" << searchArea;
-  }
+  std::vector<FrameSpanMatch> matches;
+  // the best areas for each scene, see Parameters::candidateMatches
+  std::vector<MatchingArea> candidates;
+};
+
+static SegmentMatches find_matches_in_segment(const FrameSpan& segment,
+                                              const FrameSpan& searchArea,
+                                              const Parameters& algoParams,
+                                              const HashIndex* index)
+{
+  MATCH_TRACE(Segments, "segment").field("segment", segment).field("area", searchArea);
 
-  std::vector<FrameSpanMatch> result;
+  SegmentMatches result;
 
   const std::vector<FrameSpan> scenes = split_at_scframes(segment);
 
+  const size_t nb_candidates = size_t(std::max(algoParams.candidateMatches, 0));
+
+  auto find_match_start = [&](const FrameSpan& pattern, SearchCandidates* candidates) {
+    return index ? find_best_matching_area_seeded(pattern, searchArea, *index, algoParams, candidates)
+                 : find_best_matching_area_ex(pattern, searchArea, algoParams, candidates);
+  };
+
   auto it = scenes.begin();
   while (it != scenes.end())
   {
-    MatchingArea m;
-
     // We consider the current scene, and try to find a match for it in the
     // search area.
     // If the current scene isn't the last, we search for a match that also
     // include the next scene in order to reduce the probability of a false
     // match.
+    FrameSpan pattern = *it;
     if (std::next(it) != scenes.end())
     {
       // This "extended_pattern" is a fix for episode 31.
@@ -1090,62 +1898,65 @@ static std::vector<FrameSpanMatch> find_matches_in_segment(const FrameSpan& segm
       // By extending the pattern to the next segment, we reduce the probability of an erroneous match.
       // The idea is more or less always the same: the bigger the pattern, the less likely
       // to match the wrong frames.
-      const FrameSpan extended_pattern{*it->video,
-                                       it->startOffset(),
-                                       std::next(it)->endOffset() - it->startOffset()};
-      m = find_best_matching_area_ex(extended_pattern, searchArea);
-      const size_t pattern_extra_size = std::next(it)->size();
-      m.pattern.count -= pattern_extra_size;
-      m.match.count -= pattern_extra_size;
+      pattern = FrameSpan{*it->video,
+                          it->startOffset(),
+                          std::next(it)->endOffset() - it->startOffset()};
     }
-    else
+
+    const size_t pattern_extra_size = pattern.size() - it->size();
+    SearchCandidates candidates{nb_candidates, pattern.size()};
+    MatchingArea m = find_match_start(pattern, nb_candidates > 0 ? &candidates : nullptr);
+    m.pattern.count -= pattern_extra_size;
+    m.match.count -= pattern_extra_size;
+
+    // The alternatives are found with the same pattern, but only cover the scene.
+    // They are also kept for the scenes that are not matched, as that is where
+    // the editor needs them.
+    for (MatchingArea& candidate : candidate_areas(candidates, pattern, *searchArea.video))
     {
-      m = find_best_matching_area_ex(*it, searchArea);
+      candidate.pattern.count -= pattern_extra_size;
+      candidate.match.count -= pattern_extra_size;
+      result.candidates.push_back(candidate);
     }
 
     // If the match isn't good enough, we go on to the next scene.
     if (m.score > algoParams.areaMatchThreshold)
     {
-      if (debugmatches)
-      {
-        qDebug() << "  X" << *it;
-      }
+      MATCH_TRACE(Scenes, "unmatched").field("scene", *it).field("score", m.score);
 
       ++it;
       continue;
     }
 
-    if (debugmatches)
-    {
-      qDebug() << " >" << m.pattern << " ~ " << m.match;
-    }
+    MATCH_TRACE(Scenes, "candidate")
+        .field("pattern", m.pattern)
+        .field("match", m.match)
+        .field("score", m.score);
 
     // We then try to extend the match to the next scenes.
     auto [end_it, last_match_from_sa] = extend_match(m,
                                                      std::next(it),
                                                      scenes.end(),
                                                      searchArea.endOffset(),
-                                                     algoParams);
+                                                     algoParams,
+                                                     nb_candidates > 0 ? &result.candidates : nullptr);
 
     //   FrameSpan last_match_from_pattern = *std::prev(end_it);
     //   m.pattern.count = last_match_from_pattern.endOffset() - m.pattern.startOffset();
     m.match.count = last_match_from_sa.endOffset() - m.match.startOffset();
 
-    if (debugmatches)
-    {
-      qDebug() << "  >>" << merge(*it, *std::prev(end_it)) << " ~ " << m.match;
-    }
+    MATCH_TRACE(Scenes, "extend")
+        .field("pattern", merge(*it, *std::prev(end_it)))
+        .field("match", m.match)
+        .field("scenes", size_t(std::distance(it, end_it)));
 
     // Finally, we perform some adjustments to the match, notably to remove or add
     // a few frames at the beginning or end of the match.
     std::tie(m.pattern, m.match) = refine_match(it, end_it, m.match, searchArea, algoParams);
 
-    if (debugmatches)
-    {
-      qDebug() << "  >>>" << m.pattern << " ~ " << m.match;
-    }
+    MATCH_TRACE(Scenes, "refine").field("pattern", m.pattern).field("match", m.match);
 
-    append_match(result, FrameSpanMatch(m.pattern, m.match));
+    append_match(result.matches, FrameSpanMatch(m.pattern, m.match));
 
     it = end_it;
   }
@@ -1170,9 +1981,24 @@ VideoMatch to_match(const std::pair<FrameSpan, FrameSpan>& m)
   return result;
 }
 
+MatchCandidate to_candidate(const MatchingArea& area)
+{
+  MatchCandidate result;
+  result.match = to_match(FrameSpanMatch(area.pattern, area.match));
+  result.score = area.score;
+  result.minDistance = 64;
+  for (size_t i(0); i < area.pattern.size(); ++i)
+  {
+    result.minDistance = std::min(result.minDistance, phashDist(area.pattern.hash(i), area.match.hash(i)));
+  }
+  return result;
+}
+
 std::vector<VideoMatch> find_matches(const FrameSpan& a,
                                      const FrameSpan& b,
-                                     const Parameters& params)
+                                     const Parameters& params,
+                                     const HashIndex* index = nullptr,
+                                     std::vector<MatchCandidate>* candidates = nullptr)
 {
   FrameSpan search_area = b;
 
@@ -1189,11 +2015,17 @@ std::vector<VideoMatch> find_matches(const FrameSpan& a,
   {
     assert(segment.size() > 0);
 
-    std::vector<FrameSpanMatch> matchingspans = find_matches_in_segment(segment,
-                                                                        search_area,
-                                                                        params);
+    SegmentMatches segment_matches = find_matches_in_segment(segment, search_area, params, index);
+
+    if (candidates)
+    {
+      for (const MatchingArea& candidate : segment_matches.candidates)
+      {
+        candidates->push_back(to_candidate(candidate));
+      }
+    }
 
-    for (const auto& m : matchingspans)
+    for (const auto& m : segment_matches.matches)
     {
       matches.push_back(to_match(m));
       search_area = FrameSpan(*b.video, m.second.endOffset(), -1);
@@ -1205,27 +2037,27 @@ std::vector<VideoMatch> find_matches(const FrameSpan& a,
 
 FrameSpan to_framespan(const Video& v, const TimeSegment& tseg)
 {
-  auto get_frame_timestamp = [&v](const Frame& frame) -> int64_t {
-    return std::round(frame.pts * v.frameDelta * 1000);
+  auto get_frame_timestamp = [&v](int pts) -> int64_t {
+    return std::round(pts * v.frameDelta * 1000);
   };
 
-  auto it = std::lower_bound(v.frames.begin(),
-                             v.frames.end(),
+  auto it = std::lower_bound(v.pts.begin(),
+                             v.pts.end(),
                              tseg.start(),
-                             [&get_frame_timestamp](const Frame& e, int64_t val) {
+                             [&get_frame_timestamp](int e, int64_t val) {
                                return get_frame_timestamp(e) < val;
                              });
 
-  const size_t start_frame = std::distance(v.frames.begin(), it);
+  const size_t start_frame = std::distance(v.pts.begin(), it);
 
-  it = std::lower_bound(v.frames.begin(),
-                        v.frames.end(),
+  it = std::lower_bound(v.pts.begin(),
+                        v.pts.end(),
                         tseg.end(),
-                        [&get_frame_timestamp](const Frame& e, int64_t val) {
+                        [&get_frame_timestamp](int e, int64_t val) {
                           return get_frame_timestamp(e) < val;
                         });
 
-  const size_t end_frame = std::distance(v.frames.begin(), it);
+  const size_t end_frame = std::distance(v.pts.begin(), it);
 
   return FrameSpan(v, start_frame, end_frame - start_frame);
 }
@@ -1234,11 +2066,28 @@ std::vector<VideoMatch> find_matches(const Video& a,
                                      const TimeSegment& segmentA,
                                      const Video& b,
                                      const TimeSegment& segmentB,
-                                     const Parameters& params)
+                                     const Parameters& params,
+                                     const HashIndex* index = nullptr,
+                                     std::vector<MatchCandidate>* candidates = nullptr)
 {
   // TODO: passer ça dans la classe MatchDetector.
   // il faut en effet se souvenir que l'on ne doit jamais sortir des deux segments.
-  return find_matches(to_framespan(a, segmentA), to_framespan(b, segmentB), params);
+  if (params.engine == MatchEngine::GlobalAlignment || params.engine == MatchEngine::TimeWarp)
+  {
+    assert(index);
+    const FrameSpan span_a = to_framespan(a, segmentA);
+    const FrameSpan span_b = to_framespan(b, segmentB);
+
+    std::vector<VideoMatch> matches;
+    for (const auto& m : params.engine == MatchEngine::TimeWarp ? match_time_warp(span_a, span_b, *index, params)
+                                                                : align_frames(span_a, span_b, *index, params))
+    {
+      matches.push_back(to_match(m));
+    }
+    return matches;
+  }
+
+  return find_matches(to_framespan(a, segmentA), to_framespan(b, segmentB), params, index, candidates);
 }
 
 } // namespace MatchAlgo
@@ -1250,15 +2099,22 @@ Video::Video(const MediaObject& media)
 {
   this->frameDelta = this->media->frameDelta();
 
-  const std::vector<VideoFrameInfo>& vframes = media.framesInfo()->frames;
-  this->frames.reserve(vframes.size());
+  this->hashes = media.framesInfo()->hashes();
+  this->pts = media.framesInfo()->pts();
+
+  this->flags.assign(this->hashes.size(), 0);
+  this->scscores.assign(this->hashes.size(), 0.f);
 
-  for (const VideoFrameInfo& f : vframes)
+  size_t factor = PyramidFactor;
+  while (this->pyramid.size() < size_t(MaxPyramidLevel) && factor <= this->hashes.size())
   {
-    Frame e;
-    e.pts = f.pts;
-    e.phash = f.phash;
-    this->frames.push_back(e);
+    HashVector& level = this->pyramid.emplace_back();
+    level.reserve((this->hashes.size() + factor - 1) / factor);
+    for (size_t i(0); i < this->hashes.size(); i += factor)
+    {
+      level.push_back(this->hashes[i]);
+    }
+    factor *= PyramidFactor;
   }
 
   // ?TODO: add a "sentinel" frame?
@@ -1291,12 +2147,14 @@ MatchDetector::MatchDetector(const MediaObject& a, const MediaObject& b)
 
 std::vector<VideoMatch> MatchDetector::run()
 {
+  ProfileScope profile_scope{"match", "MatchDetector::run"};
+
   MatchAlgo::Video a{*m_a};
   MatchAlgo::Video b{*m_b};
 
   MatchAlgo::mark_silence_frames(a);
 
-  MatchAlgo::silenceborders(a.frames);
+  MatchAlgo::silenceborders(a);
 
   MatchAlgo::mark_black_frames(a);
 
@@ -1304,5 +2162,45 @@ std::vector<VideoMatch> MatchDetector::run()
 
   MatchAlgo::merge_small_scenes(a, 7);
 
-  return MatchAlgo::find_matches(a, this->segmentA, b, this->segmentB, this->parameters);
+  // the index covers the whole video, the searches are restricted to segmentB
+  std::optional<MatchAlgo::HashIndex> index;
+  if (this->parameters.engine != MatchAlgo::MatchEngine::Exhaustive)
+  {
+    ProfileScope index_scope{"match", "HashIndex"};
+    index.emplace(b);
+  }
+
+  const MatchAlgo::SearchStats stats_before = MatchAlgo::searchStats();
+
+  m_candidates.clear();
+
+  ProfileScope find_scope{"match", "find_matches"};
+  std::vector<VideoMatch> result = MatchAlgo::find_matches(a,
+                                                           this->segmentA,
+                                                           b,
+                                                           this->segmentB,
+                                                           this->parameters,
+                                                           index ? &*index : nullptr,
+                                                           &m_candidates);
+
+  if (MatchAlgo::isTraceEnabled(MatchAlgo::TraceLevel::Summary))
+  {
+    const MatchAlgo::SearchStats stats = MatchAlgo::searchStats() - stats_before;
+    MATCH_TRACE(Summary, "stats")
+        .field("matches", result.size())
+        .field("offsets", stats.offsets)
+        .field("offsetsSkipped", stats.offsetsSkipped)
+        .field("offsetsAbandoned", stats.offsetsAbandoned)
+        .field("distances", stats.distances)
+        .field("distancesPruned", stats.distancesPruned)
+        .field("fftSearches", stats.fftSearches)
+        .field("pyramidSearches", stats.pyramidSearches);
+  }
+
+  return result;
+}
+
+const std::vector<MatchCandidate>& MatchDetector::candidates() const
+{
+  return m_candidates;
 }
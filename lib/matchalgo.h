@@ -10,6 +10,8 @@
 // TODO: remove these
 #include "mediainfo.h"
 
+#include <new>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -31,34 +33,149 @@ class MediaObject;
 
 namespace MatchAlgo {
 
+enum class MatchEngine {
+  // searches each scene in the whole remaining part of the second video
+  Exhaustive,
+  // only searches around the frames of the second video whose hash is nearly
+  // identical to the hash of a frame of the scene (the "seeds"), found with a HashIndex
+  SeedAndExtend,
+  // aligns the two videos as a whole with dynamic time warping, see align_frames()
+  GlobalAlignment,
+  // fits a piecewise-linear mapping between the two videos to similar frames,
+  // see TimeWarpModel
+  TimeWarp,
+};
+
 struct Parameters
 {
   int frameUnmatchThreshold = 21;
   int frameRematchThreshold = 16;
   double areaMatchThreshold = 20;
   double scdetThreshold = 0;
+  // skip offsets that cannot beat the best match found so far (results are the same)
+  bool pruneSearch = true;
+  // use FFTs for long searches when this is faster (results are the same)
+  bool fftSearch = true;
+  // split long searches across threads (results are the same)
+  bool parallelSearch = true;
+  // search long search areas on the temporal pyramid first, then only refine
+  // around the best candidates at full resolution (results may differ)
+  bool pyramidSearch = false;
+  MatchEngine engine = MatchEngine::Exhaustive;
+  // maximum distance between two frames for them to be used as a seed
+  // (or as an anchor of the global alignment and of the time-warp model);
+  // below 8, the hash index only visits 17 buckets per table.
+  int seedRadius = 7;
+  // number of candidate matches kept for each scene, see MatchDetector::candidates();
+  // they are the best offsets visited by the search of the scene, which prunes less
+  // (only with the Exhaustive and SeedAndExtend engines)
+  int candidateMatches = 0;
 };
 
-struct Frame
+// Work done by the sliding-window searches, accumulated over all threads.
+struct SearchStats
 {
-  int pts;
-  quint64 phash;
+  quint64 offsets = 0;
+  quint64 offsetsSkipped = 0;   // discarded without computing any distance
+  quint64 offsetsAbandoned = 0; // discarded before the whole pattern was compared
+  quint64 distances = 0;        // frame distances computed
+  quint64 distancesPruned = 0;  // frame distances that did not need to be computed
+  quint64 fftSearches = 0;      // searches done with hammingDistanceProfile()
+  quint64 pyramidSearches = 0;  // searches started on the temporal pyramid
+};
 
-  // Les infos suivantes ne sont calculées que pour la vidéo principale
-  bool silence = false;
-  bool black = false;
-  float scscore = 0; // > 0 pour un changmenet de scène
+inline SearchStats operator-(const SearchStats& lhs, const SearchStats& rhs)
+{
+  SearchStats result;
+  result.offsets = lhs.offsets - rhs.offsets;
+  result.offsetsSkipped = lhs.offsetsSkipped - rhs.offsetsSkipped;
+  result.offsetsAbandoned = lhs.offsetsAbandoned - rhs.offsetsAbandoned;
+  result.distances = lhs.distances - rhs.distances;
+  result.distancesPruned = lhs.distancesPruned - rhs.distancesPruned;
+  result.fftSearches = lhs.fftSearches - rhs.fftSearches;
+  result.pyramidSearches = lhs.pyramidSearches - rhs.pyramidSearches;
+  return result;
+}
+
+SearchStats searchStats();
+void resetSearchStats();
+
+// Allocator returning cache-line aligned memory, used for the levels of the
+// temporal pyramid. The hashes of the frames are a view of the FramesInfo of
+// the media instead, which are only aligned like this when mapped from a file.
+// The kernels use unaligned loads either way, since a sliding window may
+// start at any frame.
+template<typename T, size_t Alignment = 64>
+struct AlignedAllocator
+{
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+  {}
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* p, size_t)
+  {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  bool operator==(const AlignedAllocator&) const { return true; }
+  bool operator!=(const AlignedAllocator&) const { return false; }
+};
+
+using HashVector = std::vector<quint64, AlignedAllocator<quint64>>;
+
+enum FrameFlag : quint8 {
+  SilenceFrame = 1,
+  BlackFrame = 2,
 };
 
+// The frames of a video, stored as a structure of arrays.
+// Most of the matching time is spent computing distances between hashes,
+// so these are kept contiguous and separate from the other data.
 class Video
 {
 public:
   const MediaObject* media;
   double frameDelta;
-  std::vector<Frame> frames;
+  // views of the frames of the media, which must outlive the video
+  std::span<const quint64> hashes;
+  std::span<const int> pts;
+
+  // temporal pyramid: level l (l >= 1) holds the hash of every (4^l)-th frame
+  std::vector<HashVector> pyramid;
+
+  // Les infos suivantes ne sont calculées que pour la vidéo principale
+  std::vector<quint8> flags;   // FrameFlag
+  std::vector<float> scscores; // > 0 pour un changement de scène
 
 public:
   explicit Video(const MediaObject& media);
+
+  static constexpr size_t PyramidFactor = 4;
+  static constexpr int MaxPyramidLevel = 3;
+
+  size_t size() const { return hashes.size(); }
+
+  int pyramidLevels() const { return int(pyramid.size()); }
+  const HashVector& pyramidLevel(int level) const { return pyramid.at(level - 1); }
+
+  bool isSilence(size_t i) const { return flags[i] & SilenceFrame; }
+  bool isBlack(size_t i) const { return flags[i] & BlackFrame; }
+  bool isSceneChange(size_t i) const { return scscores[i] > 0; }
 };
 
 class FrameSpan
@@ -80,15 +197,36 @@ public:
       , first(offset)
       , count(n)
   {
-    first = std::min(first, video->frames.size());
-    count = std::min(count, video->frames.size() - first);
+    first = std::min(first, video->size());
+    count = std::min(count, video->size() - first);
   }
 
   size_t size() const { return count; }
-  const Frame& at(size_t i) const
+
+  const quint64* hashes() const { return video->hashes.data() + first; }
+
+  quint64 hash(size_t i) const
   {
     assert(i < count);
-    return video->frames.at(first + i);
+    return video->hashes[first + i];
+  }
+
+  bool isSilence(size_t i) const
+  {
+    assert(i < count);
+    return video->isSilence(first + i);
+  }
+
+  bool isBlack(size_t i) const
+  {
+    assert(i < count);
+    return video->isBlack(first + i);
+  }
+
+  bool isSceneChange(size_t i) const
+  {
+    assert(i < count);
+    return video->isSceneChange(first + i);
   }
 
   size_t startOffset() const { return first; }
@@ -112,7 +250,7 @@ public:
     num = std::min(this->first, num);
     this->first -= num;
     this->count += num;
-    assert(endOffset() <= this->video->frames.size());
+    assert(endOffset() <= this->video->size());
   }
 
   void trimLeft(size_t num)
@@ -187,9 +325,16 @@ public:
 
   std::vector<VideoMatch> run();
 
+  // The best matches of each scene searched by run(), best first for each scene,
+  // if Parameters::candidateMatches is set.
+  // The scenes a match was extended to are only searched near the end of the
+  // previous scene, so they have fewer candidates.
+  const std::vector<MatchCandidate>& candidates() const;
+
 private:
   const MediaObject* m_a;
   const MediaObject* m_b;
+  std::vector<MatchCandidate> m_candidates;
   // TODO: ajouter un système de log
 };
 
@@ -0,0 +1,148 @@
+#include "matchtrace.h"
+
+#include "matchalgo.h"
+
+#include <QFile>
+#include <QString>
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+namespace MatchAlgo {
+
+namespace detail {
+std::atomic<int> traceLevel{int(TraceLevel::Off)};
+} // namespace detail
+
+namespace {
+
+struct TraceFile
+{
+  std::mutex mutex;
+  QFile file;
+  std::chrono::steady_clock::time_point start;
+};
+
+TraceFile trace_file;
+
+// small numbers are easier to read than std::thread::id
+int current_thread_number()
+{
+  static std::atomic<int> next_number{0};
+  thread_local const int number = next_number++;
+  return number;
+}
+
+void append_string(std::string& json, const char* text)
+{
+  json += '"';
+  for (const char* c = text; *c; ++c)
+  {
+    if (*c == '"' || *c == '\\')
+    {
+      json += '\\';
+      json += *c;
+    }
+    else if (static_cast<unsigned char>(*c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(*c));
+      json += escaped;
+    }
+    else
+    {
+      json += *c;
+    }
+  }
+  json += '"';
+}
+
+} // namespace
+
+bool startTrace(const QString& filePath, TraceLevel level)
+{
+  std::lock_guard lock{trace_file.mutex};
+
+  trace_file.file.close();
+  trace_file.file.setFileName(filePath);
+  if (!trace_file.file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    detail::traceLevel = int(TraceLevel::Off);
+    return false;
+  }
+
+  trace_file.start = std::chrono::steady_clock::now();
+  detail::traceLevel = int(level);
+  return true;
+}
+
+void stopTrace()
+{
+  std::lock_guard lock{trace_file.mutex};
+  detail::traceLevel = int(TraceLevel::Off);
+  trace_file.file.close();
+}
+
+TraceEvent::TraceEvent(const char* name)
+{
+  const auto elapsed = std::chrono::steady_clock::now() - trace_file.start;
+
+  m_json = "{\"event\":";
+  append_string(m_json, name);
+  m_json += ",\"t\":";
+  m_json += std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  m_json += ",\"thread\":";
+  m_json += std::to_string(current_thread_number());
+}
+
+TraceEvent::~TraceEvent()
+{
+  m_json += "}\n";
+
+  std::lock_guard lock{trace_file.mutex};
+  if (trace_file.file.isOpen())
+  {
+    trace_file.file.write(m_json.data(), qint64(m_json.size()));
+  }
+}
+
+TraceEvent& TraceEvent::field(const char* key, double value)
+{
+  if (!std::isfinite(value))
+  {
+    return rawField(key, "null");
+  }
+
+  // unlike printf(), to_chars() does not depend on the locale
+  char text[32];
+  const auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+  return rawField(key, std::string(text, result.ptr));
+}
+
+TraceEvent& TraceEvent::field(const char* key, const char* value)
+{
+  std::string json;
+  append_string(json, value);
+  return rawField(key, json);
+}
+
+TraceEvent& TraceEvent::field(const char* key, const FrameSpan& span)
+{
+  return rawField(key,
+                  "{\"first\":" + std::to_string(span.startOffset()) + ",\"count\":"
+                      + std::to_string(span.size()) + "}");
+}
+
+TraceEvent& TraceEvent::rawField(const char* key, const std::string& json)
+{
+  m_json += ',';
+  append_string(m_json, key);
+  m_json += ':';
+  m_json += json;
+  return *this;
+}
+
+} // namespace MatchAlgo
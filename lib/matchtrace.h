@@ -0,0 +1,95 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef MATCHTRACE_H
+#define MATCHTRACE_H
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+class QString;
+
+// Highest level of the trace events that are compiled in (see MatchAlgo::TraceLevel).
+// The events of higher levels cost nothing, not even a test.
+#ifndef MATCHALGO_TRACE_MAX_LEVEL
+#define MATCHALGO_TRACE_MAX_LEVEL 3
+#endif
+
+namespace MatchAlgo {
+
+class FrameSpan;
+
+// Levels of detail of the trace of the match algorithm; each level includes the previous ones.
+enum class TraceLevel {
+  Off = 0,
+  // statistics of each run, models of the global engines
+  Summary = 1,
+  // the segments of the first video, the pieces of the time-warp model
+  Segments = 2,
+  // the match found for each scene, and how it is extended and refined
+  Scenes = 3,
+  // every search of find_best_matching_area()
+  Searches = 4,
+};
+
+// Starts writing the trace events up to `level` to a file, as JSON lines:
+// one object per line, with the name of the event, the time in microseconds
+// since the start of the trace, the thread and the fields of the event.
+// Frame spans are written as {"first": ..., "count": ...}, in frames of their video.
+// Returns false if the file cannot be opened.
+bool startTrace(const QString& filePath, TraceLevel level);
+void stopTrace();
+
+namespace detail {
+extern std::atomic<int> traceLevel;
+} // namespace detail
+
+inline bool isTraceEnabled(TraceLevel level)
+{
+  return int(level) <= detail::traceLevel.load(std::memory_order_relaxed);
+}
+
+// An event of the trace, written when it is destroyed.
+// Use MATCH_TRACE() rather than creating one directly.
+class TraceEvent
+{
+public:
+  explicit TraceEvent(const char* name);
+  TraceEvent(const TraceEvent&) = delete;
+  ~TraceEvent();
+
+  template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+  TraceEvent& field(const char* key, T value)
+  {
+    return rawField(key, std::to_string(value));
+  }
+
+  TraceEvent& field(const char* key, double value);
+  TraceEvent& field(const char* key, const char* value);
+  TraceEvent& field(const char* key, const FrameSpan& span);
+
+private:
+  TraceEvent& rawField(const char* key, const std::string& json);
+
+private:
+  std::string m_json;
+};
+
+} // namespace MatchAlgo
+
+// Writes a trace event of the given level, with the fields added with TraceEvent::field():
+//   MATCH_TRACE(Scenes, "refine").field("pattern", m.pattern).field("match", m.match);
+// The fields are not even evaluated if the level is disabled.
+#define MATCH_TRACE(level, name) \
+  if constexpr (int(MatchAlgo::TraceLevel::level) > MATCHALGO_TRACE_MAX_LEVEL) \
+  { \
+  } \
+  else if (!MatchAlgo::isTraceEnabled(MatchAlgo::TraceLevel::level)) \
+  { \
+  } \
+  else \
+    MatchAlgo::TraceEvent(name)
+
+#endif // MATCHTRACE_H
@@ -7,12 +7,17 @@
 
 #include "cache.h"
 #include "exerun.h"
+#include "profiler.h"
 #include "wav.h"
 
+#include <QFile>
 #include <QFileInfo>
+#include <QMap>
 #include <QTimer>
 #include <QUuid>
 
+#include <cmath>
+
 class FFprobeOutputExtractor
 {
 private:
@@ -67,6 +72,7 @@ public:
 
   void run() override
   {
+    ProfileScope profile_scope{"media", "WaveformReadingThread::run", filePath};
     readSamples = readWav(this->filePath);
 
     // for (size_t i(1000); i < std::min(size_t(1100), m_audioInfo->samples.size()); ++i)
@@ -100,27 +106,94 @@ WavSample AudioWaveformInfo::getSampleForTime(int64_t pos) const
 MediaObject::MediaObject(const QString& filePath, QObject* parent)
     : QObject(parent)
     , m_filePath(filePath)
+{
+  ProfileScope profile_scope{"media", "MediaObject::MediaObject", fileName()};
+
+  m_fingerprint = GetMediaFingerprint(filePath);
+  if (m_fingerprint.isEmpty())
+  {
+    throw std::runtime_error("could not read " + filePath.toStdString());
+  }
+
+  if (!readProbeCache())
+  {
+    probe();
+    writeProbeCache();
+  }
+}
+
+std::unique_ptr<MediaObject> MediaObject::fromCache(const QString& filePath)
+{
+  auto media = std::make_unique<MediaObject>(filePath, 0, std::make_pair(0, 1));
+  media->m_fingerprint = FindMediaFingerprint(filePath);
+
+  if (media->m_fingerprint.isEmpty() || !media->readProbeCache())
+  {
+    throw std::runtime_error("no probe results in cache for " + media->fileName().toStdString());
+  }
+
+  media->m_frames = FramesInfo::load(FrameExtractionThread::cacheFilePath(media->cacheKey()), media->cacheKey());
+
+  if (!media->m_frames)
+  {
+    throw std::runtime_error("no frames in cache for " + media->fileName().toStdString());
+  }
+
+  const QString silences_path = SilencedetectThread::cacheFilePath(media->cacheKey());
+  auto silences = std::make_unique<SilenceInfo>();
+  silences->minimumDuration = SilencedetectThread::duration();
+  if (QFileInfo::exists(silences_path)
+      && read_silencedetect_from_disk(silences->silences, silences->minimumDuration, silences_path))
+  {
+    media->m_silenceInfo = std::move(silences);
+  }
+
+  const QString blackframes_path = BlackdetectThread::cacheFilePath(media->cacheKey());
+  auto blackframes = std::make_unique<BlackFramesInfo>();
+  blackframes->minimumDuration = BlackdetectThread::duration();
+  if (QFileInfo::exists(blackframes_path)
+      && read_blackdetect_from_disk(blackframes->blackframes, blackframes->minimumDuration, blackframes_path))
+  {
+    media->m_blackFrames = std::move(blackframes);
+  }
+
+  const QString scenes_path = ScdetThread::cacheFilePath(media->cacheKey());
+  auto scenes = std::make_unique<ScenesInfo>();
+  if (QFileInfo::exists(scenes_path) && read_scdet_results_from_disk(scenes->scenechanges, scenes_path))
+  {
+    media->m_scenes = std::move(scenes);
+  }
+
+  return media;
+}
+
+// Reads the container metadata only, which is fast even on a network drive;
+// the number of frames is estimated from it.
+void MediaObject::probe()
 {
   QString output;
   auto args = QStringList() << "-v"
                             << "0"
                             << "-select_streams"
                             << "v:0"
-                            << "-count_packets"
                             << "-show_entries"
-                            << "stream=r_frame_rate,nb_read_packets"
+                            << "stream=r_frame_rate,nb_frames:stream_tags"
                             << "-show_entries"
                             << "format_tags"
                             << "-show_entries"
-                            << "format=duration" << filePath;
+                            << "format=duration" << filePath();
   ffprobe(args, &output);
 
-  FFprobeOutputExtractor extractor{output};
-  m_duration = extractor.extract("duration").toDouble();
-  m_readPackets = extractor.extract("nb_read_packets").toInt();
+  // the title of the video track must not be taken for the title of the media
+  const qsizetype format_index = output.indexOf("[FORMAT]");
+  const FFprobeOutputExtractor stream{output.left(format_index)};
+  const FFprobeOutputExtractor format{format_index == -1 ? QString() : output.mid(format_index)};
+
+  m_duration = format.extract("duration").toDouble();
+  m_title = format.tryExtract("TAG:title");
 
   {
-    QStringList parts = extractor.extract("r_frame_rate").split('/');
+    QStringList parts = stream.extract("r_frame_rate").split('/');
     if (parts.size() != 2)
     {
       throw std::runtime_error("bad r_frame_rate value");
@@ -130,9 +203,91 @@ MediaObject::MediaObject(const QString& filePath, QObject* parent)
     m_frameRate.second = parts.at(1).toInt();
   }
 
-  m_title = extractor.tryExtract("TAG:title");
+  // mp4 files have the number of frames in their header, mkvmerge writes
+  // it in the statistics tags of the track
+  m_estimatedFrames = 0;
+  for (const char* key : {"nb_frames", "TAG:NUMBER_OF_FRAMES", "TAG:NUMBER_OF_FRAMES-eng"})
+  {
+    m_estimatedFrames = stream.tryExtract(key).toInt();
+    if (m_estimatedFrames > 0)
+    {
+      break;
+    }
+  }
+
+  if (m_estimatedFrames <= 0)
+  {
+    m_estimatedFrames = int(std::round(m_duration * frameRate()));
+  }
+}
+
+// Returns false if the probe results are not in the cache.
+bool MediaObject::readProbeCache()
+{
+  QFile file{GetCacheFilePath(m_fingerprint, "probe")};
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  QMap<QString, QString> values;
+  for (const QString& line : QString::fromUtf8(file.readAll()).split('\n', Qt::SkipEmptyParts))
+  {
+    const qsizetype i = line.indexOf('=');
+    if (i != -1)
+    {
+      values[line.left(i)] = line.mid(i + 1);
+    }
+  }
+
+  const QStringList frame_rate = values.value("frame_rate").split('/');
+  if (!values.contains("estimated_frames") || frame_rate.size() != 2)
+  {
+    return false;
+  }
+
+  m_title = values.value("title");
+  m_duration = values.value("duration").toDouble();
+  m_frameRate.first = frame_rate.at(0).toInt();
+  m_frameRate.second = frame_rate.at(1).toInt();
+  m_estimatedFrames = values.value("estimated_frames").toInt();
+  return true;
 }
 
+void MediaObject::writeProbeCache() const
+{
+  CreateCacheDir();
+
+  QFile file{GetCacheFilePath(m_fingerprint, "probe")};
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    qDebug() << "could not write " << file.fileName();
+    return;
+  }
+
+  QString text;
+  text += "title=" + QString(m_title).replace('\n', ' ') + "\n";
+  text += "duration=" + QString::number(m_duration, 'g', 12) + "\n";
+  text += "frame_rate=" + QString::number(m_frameRate.first) + "/" + QString::number(m_frameRate.second) + "\n";
+  text += "estimated_frames=" + QString::number(m_estimatedFrames) + "\n";
+  file.write(text.toUtf8());
+}
+
+QString MediaObject::cacheKey() const
+{
+  return m_fingerprint;
+}
+
+MediaObject::MediaObject(const QString& filePath,
+                         double duration,
+                         const std::pair<int, int>& frameRate,
+                         QObject* parent)
+    : QObject(parent)
+    , m_filePath(filePath)
+    , m_duration(duration)
+    , m_frameRate(frameRate)
+{}
+
 MediaObject::~MediaObject()
 {
   if (audioInfo())
@@ -155,15 +310,13 @@ QString MediaObject::fileName() const
 TimeSegment MediaObject::convertFrameRangeToTimeSegment(int firstFrameIdx, int lastFrameIdx) const
 {
   Q_ASSERT(framesInfo());
-  const std::vector<VideoFrameInfo>& fs = framesInfo()->frames;
+  const std::span<const int> pts = framesInfo()->pts();
 
   Q_ASSERT(firstFrameIdx < lastFrameIdx);
-  Q_ASSERT(firstFrameIdx >= 0 && lastFrameIdx < fs.size());
+  Q_ASSERT(firstFrameIdx >= 0 && lastFrameIdx < pts.size());
 
-  const auto& first_frame = fs.at(firstFrameIdx);
-  const auto& last_frame = fs.at(lastFrameIdx);
-  const int64_t start = convertPtsToPosition(first_frame.pts);
-  const int64_t end = convertPtsToPosition(last_frame.pts + 1);
+  const int64_t start = convertPtsToPosition(pts[firstFrameIdx]);
+  const int64_t end = convertPtsToPosition(pts[lastFrameIdx] + 1);
   return TimeSegment::between(start, end);
 }
 
@@ -183,10 +336,15 @@ void MediaObject::extractFrames()
   m_frameExtractionThread->start();
 }
 
+void MediaObject::setFramesInfo(std::unique_ptr<FramesInfo> info)
+{
+  m_frames = std::move(info);
+  m_estimatedFrames = m_frames ? int(m_frames->size()) : 0;
+}
+
 void MediaObject::onFrameExtractionFinished()
 {
-  m_frames = std::make_unique<FramesInfo>();
-  m_frames->frames = std::move(m_frameExtractionThread->frames());
+  m_frames = m_frameExtractionThread->takeFrames();
   QTimer::singleShot(10, [this]() { m_frameExtractionThread.reset(); });
 
   Q_EMIT framesAvailable();
@@ -218,6 +376,11 @@ SilencedetectThread* MediaObject::silencedetectThread() const
   return m_silencedetectThread.get();
 }
 
+void MediaObject::setSilenceInfo(std::unique_ptr<SilenceInfo> info)
+{
+  m_silenceInfo = std::move(info);
+}
+
 void MediaObject::onSilencedetectFinished()
 {
   m_silenceInfo = std::make_unique<SilenceInfo>();
@@ -249,6 +412,11 @@ BlackdetectThread* MediaObject::blackdetectThread() const
   return m_blackdetectThread.get();
 }
 
+void MediaObject::setBlackFramesInfo(std::unique_ptr<BlackFramesInfo> info)
+{
+  m_blackFrames = std::move(info);
+}
+
 void MediaObject::onBlackdetectFinished()
 {
   m_blackFrames = std::make_unique<BlackFramesInfo>();
@@ -280,6 +448,11 @@ ScdetThread* MediaObject::scdetThread() const
   return m_scdetThread.get();
 }
 
+void MediaObject::setScenesInfo(std::unique_ptr<ScenesInfo> info)
+{
+  m_scenes = std::move(info);
+}
+
 void MediaObject::onScdetFinished()
 {
   m_scenes = std::make_unique<ScenesInfo>();
@@ -5,16 +5,12 @@
 #ifndef MEDIAOBJECT_H
 #define MEDIAOBJECT_H
 
+#include "framesinfo.h"
 #include "mediainfo.h"
 #include "wav.h"
 
 #include <QObject>
 
-struct FramesInfo
-{
-  std::vector<VideoFrameInfo> frames;
-};
-
 struct SilenceInfo
 {
   double minimumDuration;
@@ -52,9 +48,23 @@ class MediaObject : public QObject
 {
   Q_OBJECT
 public:
+  // Probes the file, unless the results of a previous probe are in the cache.
+  // Throws std::runtime_error if the file cannot be read.
   explicit MediaObject(const QString& filePath, QObject* parent = nullptr);
+  // Creates a media whose information is already known, without probing the file
+  // (which may not exist); its data is then set with the set*Info() functions.
+  MediaObject(const QString& filePath,
+              double duration,
+              const std::pair<int, int>& frameRate,
+              QObject* parent = nullptr);
   ~MediaObject();
 
+  // Creates a media from the results of its previous analysis, read from the cache,
+  // without reading the file (which may not exist) or starting any process.
+  // The frames must be in the cache, the detections are loaded if they are.
+  // Throws std::runtime_error if the frames or the probe results are missing.
+  static std::unique_ptr<MediaObject> fromCache(const QString& filePath);
+
   const QString& filePath() const;
   QString fileName() const;
 
@@ -63,27 +73,35 @@ public:
   double duration() const;
   double frameRate() const;
   double frameDelta() const;
-  int numberOfPackets() const;
+  // Estimated from the container metadata; may be off by a few frames.
+  int estimatedNumberOfFrames() const;
   const std::pair<int, int>& frameRateAsRational() const;
 
+  // Fingerprint of the content of the file, which identifies it in the cache.
+  QString cacheKey() const;
+
   int64_t convertPtsToPosition(int pts) const;
   TimeSegment convertFrameRangeToTimeSegment(int firstFrameIdx, int lastFrameIdx) const;
 
   FramesInfo* framesInfo() const;
   void extractFrames();
   FrameExtractionThread* frameExtractionThread() const;
+  void setFramesInfo(std::unique_ptr<FramesInfo> info);
 
   SilenceInfo* silenceInfo() const;
   void silencedetect();
   SilencedetectThread* silencedetectThread() const;
+  void setSilenceInfo(std::unique_ptr<SilenceInfo> info);
 
   BlackFramesInfo* blackFramesInfo() const;
   void blackdetect();
   BlackdetectThread* blackdetectThread() const;
+  void setBlackFramesInfo(std::unique_ptr<BlackFramesInfo> info);
 
   ScenesInfo* scenesInfo() const;
   void scdet();
   ScdetThread* scdetThread() const;
+  void setScenesInfo(std::unique_ptr<ScenesInfo> info);
 
   AudioWaveformInfo* audioInfo() const;
   void extractAudioInfo();
@@ -99,12 +117,18 @@ protected Q_SLOTS:
   void onScdetFinished();
   void onAudioExtractionFinished();
 
+private:
+  void probe();
+  bool readProbeCache();
+  void writeProbeCache() const;
+
 private:
   QString m_filePath;
   QString m_title;
-  double m_duration;
+  double m_duration = 0;
   std::pair<int, int> m_frameRate;
-  int m_readPackets;
+  QString m_fingerprint;
+  int m_estimatedFrames = 0;
   std::unique_ptr<FramesInfo> m_frames;
   std::unique_ptr<FrameExtractionThread> m_frameExtractionThread;
   std::unique_ptr<SilenceInfo> m_silenceInfo;
@@ -136,9 +160,9 @@ inline double MediaObject::frameDelta() const
   return m_frameRate.second / double(m_frameRate.first);
 }
 
-inline int MediaObject::numberOfPackets() const
+inline int MediaObject::estimatedNumberOfFrames() const
 {
-  return m_readPackets;
+  return m_estimatedFrames;
 }
 
 inline const std::pair<int, int>& MediaObject::frameRateAsRational() const
@@ -0,0 +1,71 @@
+#include "parallel.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+int maxParallelThreads()
+{
+  // the calling thread counts as one of the threads
+  return std::max(QThreadPool::globalInstance()->maxThreadCount(), 1);
+}
+
+void parallelFor(size_t count, const std::function<void(size_t)>& f, int maxThreads)
+{
+  QThreadPool* pool = QThreadPool::globalInstance();
+
+  size_t nb_threads = size_t(maxParallelThreads());
+  if (maxThreads > 0)
+  {
+    nb_threads = std::min(nb_threads, size_t(maxThreads));
+  }
+  nb_threads = std::min(nb_threads, count);
+
+  std::atomic<size_t> next_index{0};
+  auto work = [&]() {
+    for (size_t i = next_index++; i < count; i = next_index++)
+    {
+      f(i);
+    }
+  };
+
+  if (nb_threads <= 1)
+  {
+    work();
+    return;
+  }
+
+  QSemaphore finished;
+  std::vector<std::unique_ptr<QRunnable>> helpers;
+
+  for (size_t i(1); i < nb_threads; ++i)
+  {
+    QRunnable* helper = QRunnable::create([&]() {
+      work();
+      finished.release();
+    });
+    helper->setAutoDelete(false);
+    helpers.emplace_back(helper);
+    pool->start(helper);
+  }
+
+  work();
+
+  // all the work has been done or is being done: helpers that did not start
+  // yet are removed from the queue, the others are waited for.
+  int nb_started = 0;
+  for (const std::unique_ptr<QRunnable>& helper : helpers)
+  {
+    if (!pool->tryTake(helper.get()))
+    {
+      ++nb_started;
+    }
+  }
+
+  finished.acquire(nb_started);
+}
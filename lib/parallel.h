@@ -0,0 +1,22 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Returns the number of threads that parallelFor() uses at most,
+// including the calling thread.
+int maxParallelThreads();
+
+// Calls f(i) for every i in [0, count), using up to `maxThreads` threads
+// (the calling thread and threads of the global thread pool; all of them if <= 0).
+// The order in which the calls are made is unspecified.
+// The calling thread takes part in the work and only waits for the tasks
+// that were actually started, so that parallelFor() can be nested.
+void parallelFor(size_t count, const std::function<void(size_t)>& f, int maxThreads = 0);
+
+#endif // PARALLEL_H
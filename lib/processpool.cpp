@@ -0,0 +1,99 @@
+#include "processpool.h"
+
+#include "processstats.h"
+#include "profiler.h"
+
+#include <QProcess>
+
+#include <QDebug>
+
+#include <algorithm>
+
+ProcessPool::ProcessPool(int maxRunning, QObject* parent)
+    : QObject(parent)
+    , m_maxRunning(std::max(1, maxRunning))
+{}
+
+ProcessPool::~ProcessPool()
+{
+  // processes still owned by the pool are deleted after our members are gone,
+  // we must not be notified of their destruction.
+  for (QProcess* process : findChildren<QProcess*>(Qt::FindDirectChildrenOnly))
+  {
+    disconnect(process, nullptr, this, nullptr);
+  }
+}
+
+int ProcessPool::maxRunning() const
+{
+  return m_maxRunning;
+}
+
+int ProcessPool::numberOfRunningProcesses() const
+{
+  return int(m_running.size());
+}
+
+int ProcessPool::numberOfPendingProcesses() const
+{
+  return int(m_pending.size());
+}
+
+QProcess* ProcessPool::run(const QString& name, const QStringList& args)
+{
+  auto* process = new QProcess(this);
+  process->setProgram(name);
+  process->setArguments(args);
+
+  connect(process, &QProcess::finished, this, [this, process]() { onProcessEnded(process); });
+  connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+    if (error == QProcess::FailedToStart)
+    {
+      onProcessEnded(process);
+    }
+  });
+  // the owner of the process may delete it while it is still running
+  connect(process, &QObject::destroyed, this, [this, process]() { onProcessEnded(process); });
+
+  profileProcess(*process);
+  watchProcessCpuTime(*process);
+
+  m_pending.push_back(process);
+  startPendingProcesses();
+
+  return process;
+}
+
+void ProcessPool::onProcessEnded(QProcess* process)
+{
+  if (m_running.erase(process) == 0)
+  {
+    return;
+  }
+
+  startPendingProcesses();
+
+  if (m_running.empty() && m_pending.empty())
+  {
+    Q_EMIT idle();
+  }
+}
+
+void ProcessPool::startPendingProcesses()
+{
+  while (int(m_running.size()) < m_maxRunning && !m_pending.empty())
+  {
+    QPointer<QProcess> process = m_pending.front();
+    m_pending.pop_front();
+
+    if (!process)
+    {
+      continue;
+    }
+
+    qDebug().noquote() << (QStringList() << process->program() << process->arguments()).join(" ");
+
+    m_running.insert(process.data());
+    process->start();
+  }
+}
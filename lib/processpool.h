@@ -0,0 +1,43 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+
+#include <deque>
+#include <set>
+
+class QProcess;
+
+// Limits the number of child processes running at the same time.
+// Processes returned by run() are started as soon as a slot is available;
+// until then they are in the NotRunning state.
+class ProcessPool : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ProcessPool(int maxRunning, QObject* parent = nullptr);
+  ~ProcessPool();
+
+  int maxRunning() const;
+  int numberOfRunningProcesses() const;
+  int numberOfPendingProcesses() const;
+
+  QProcess* run(const QString& name, const QStringList& args);
+
+Q_SIGNALS:
+  void idle();
+
+private:
+  void onProcessEnded(QProcess* process);
+  void startPendingProcesses();
+
+private:
+  int m_maxRunning;
+  std::set<QProcess*> m_running;
+  std::deque<QPointer<QProcess>> m_pending;
+};
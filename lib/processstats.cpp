@@ -0,0 +1,246 @@
+#include "processstats.h"
+
+#include <QProcess>
+
+#include <QMutex>
+#include <QVariant>
+
+#include <map>
+
+#ifdef Q_OS_WIN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct RunningProcess
+{
+#ifdef Q_OS_WIN
+  HANDLE handle;
+#else
+  int64_t startCpuTime;
+#endif
+  bool overlapped; // another watched process ran at the same time
+};
+
+// the processes of a group that have ended
+struct GroupStats
+{
+  quint64 endedProcesses = 0;
+  quint64 unknownProcesses = 0; // whose cpu time is unknown
+  int64_t cpuTime = 0;          // of the others
+};
+
+// the watched processes may belong to several threads
+QMutex processes_mutex;
+std::map<const QProcess*, RunningProcess> running_processes;
+// by group, the processes without a group are in the null one
+std::map<const void*, GroupStats> ended_processes;
+quint64 number_of_ended_processes = 0;
+
+#ifdef Q_OS_WIN
+
+int64_t to_msecs(const FILETIME& ft)
+{
+  ULARGE_INTEGER value;
+  value.LowPart = ft.dwLowDateTime;
+  value.HighPart = ft.dwHighDateTime;
+  return int64_t(value.QuadPart / 10000); // 100-nanosecond intervals
+}
+
+RunningProcess begin_measure(const QProcess& process, bool overlapped)
+{
+  // QProcess releases its handle when the process ends, we keep our own
+  // so that we can query the process times afterwards.
+  HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(process.processId()));
+  return RunningProcess{.handle = handle, .overlapped = overlapped};
+}
+
+// the times of each process are known, whether it overlapped others or not
+int64_t end_measure(const RunningProcess& process)
+{
+  if (!process.handle)
+  {
+    return -1;
+  }
+
+  FILETIME creation, exit, kernel, user;
+  const bool ok = GetProcessTimes(process.handle, &creation, &exit, &kernel, &user);
+  CloseHandle(process.handle);
+  return ok ? to_msecs(kernel) + to_msecs(user) : -1;
+}
+
+void discard_measure(const RunningProcess& process)
+{
+  if (process.handle)
+  {
+    CloseHandle(process.handle);
+  }
+}
+
+#else
+
+int64_t terminated_children_cpu_time()
+{
+  rusage usage;
+  if (getrusage(RUSAGE_CHILDREN, &usage) != 0)
+  {
+    return 0;
+  }
+
+  auto to_msecs = [](const timeval& tv) { return int64_t(tv.tv_sec) * 1000 + tv.tv_usec / 1000; };
+  return to_msecs(usage.ru_utime) + to_msecs(usage.ru_stime);
+}
+
+RunningProcess begin_measure(const QProcess& process, bool overlapped)
+{
+  Q_UNUSED(process);
+  return RunningProcess{.startCpuTime = terminated_children_cpu_time(), .overlapped = overlapped};
+}
+
+// the cpu time of a child is only known together with the one of all the children
+// that ended meanwhile, which cannot be told apart if they ran at the same time
+int64_t end_measure(const RunningProcess& process)
+{
+  return process.overlapped ? -1 : terminated_children_cpu_time() - process.startCpuTime;
+}
+
+void discard_measure(const RunningProcess& process)
+{
+  Q_UNUSED(process);
+}
+
+#endif
+
+void on_process_started(const QProcess& process)
+{
+  QMutexLocker lock{&processes_mutex};
+
+  const bool overlapped = !running_processes.empty();
+  for (auto& entry : running_processes)
+  {
+    entry.second.overlapped = true;
+  }
+
+  running_processes[&process] = begin_measure(process, overlapped);
+}
+
+void on_process_ended(QProcess& process)
+{
+  QMutexLocker lock{&processes_mutex};
+
+  auto it = running_processes.find(&process);
+  if (it == running_processes.end())
+  {
+    return;
+  }
+
+  // the process has been waited for by now, so its cpu time is accounted for
+  const int64_t cpu_time = end_measure(it->second);
+  running_processes.erase(it);
+  process.setProperty("cpuTime", qint64(cpu_time));
+
+  const auto* group_id = reinterpret_cast<const void*>(process.property("cpuTimeGroup").value<quintptr>());
+  GroupStats& group = ended_processes[group_id];
+  group.endedProcesses += 1;
+  if (cpu_time < 0)
+  {
+    group.unknownProcesses += 1;
+  }
+  else
+  {
+    group.cpuTime += cpu_time;
+  }
+  number_of_ended_processes += 1;
+}
+
+} // namespace
+
+void watchProcessCpuTime(QProcess& process)
+{
+  if (process.property("cpuTimeWatched").toBool())
+  {
+    return;
+  }
+
+  process.setProperty("cpuTimeWatched", true);
+
+  QObject::connect(&process, &QProcess::stateChanged, &process, [&process](QProcess::ProcessState state) {
+    if (state == QProcess::NotRunning)
+    {
+      on_process_ended(process);
+    }
+  });
+
+  const QProcess* key = &process;
+  QObject::connect(&process, &QObject::destroyed, [key]() {
+    QMutexLocker lock{&processes_mutex};
+    auto it = running_processes.find(key);
+    if (it != running_processes.end())
+    {
+      discard_measure(it->second);
+      running_processes.erase(it);
+    }
+  });
+
+  if (process.state() == QProcess::NotRunning)
+  {
+    QObject::connect(&process, &QProcess::started, &process, [&process]() { on_process_started(process); });
+  }
+  else
+  {
+    on_process_started(process);
+  }
+}
+
+void setProcessCpuTimeGroup(QProcess& process, const void* group)
+{
+  QMutexLocker lock{&processes_mutex};
+  process.setProperty("cpuTimeGroup", QVariant::fromValue(reinterpret_cast<quintptr>(group)));
+}
+
+int64_t processCpuTime(QProcess& process)
+{
+  const QVariant value = process.property("cpuTime");
+  return value.isValid() ? value.toLongLong() : -1;
+}
+
+ChildrenCpuTimer::ChildrenCpuTimer(const void* group)
+    : m_group(group)
+{
+  start();
+}
+
+void ChildrenCpuTimer::start()
+{
+  QMutexLocker lock{&processes_mutex};
+
+  const GroupStats& group = ended_processes[m_group];
+  m_startEndedProcesses = number_of_ended_processes;
+  m_startGroupEndedProcesses = group.endedProcesses;
+  m_startGroupUnknownProcesses = group.unknownProcesses;
+#ifdef Q_OS_WIN
+  m_startCpuTime = group.cpuTime;
+#else
+  m_startCpuTime = terminated_children_cpu_time();
+#endif
+}
+
+int64_t ChildrenCpuTimer::elapsed() const
+{
+  QMutexLocker lock{&processes_mutex};
+
+  const GroupStats& group = ended_processes[m_group];
+
+#ifdef Q_OS_WIN
+  return group.unknownProcesses == m_startGroupUnknownProcesses ? group.cpuTime - m_startCpuTime : -1;
+#else
+  // the delta also counts the processes of the other groups that ended meanwhile
+  const quint64 ended = number_of_ended_processes - m_startEndedProcesses;
+  const quint64 group_ended = group.endedProcesses - m_startGroupEndedProcesses;
+  return ended == group_ended ? terminated_children_cpu_time() - m_startCpuTime : -1;
+#endif
+}
@@ -0,0 +1,47 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstdint>
+
+class QProcess;
+
+// Starts measuring the cpu time of a child process; must be called before the
+// process ends, ideally before it is started. All the processes started by
+// this library are watched.
+void watchProcessCpuTime(QProcess& process);
+
+// Assigns a watched process to a group, e.g. the processes of an export;
+// must be called before the process ends.
+void setProcessCpuTimeGroup(QProcess& process, const void* group);
+
+// Returns the cpu time (user + system, in msecs) used by a watched child
+// process that has finished, or -1 if it is unknown.
+// On Unix, the cpu time of a child is only known together with the one of
+// all the children that ended meanwhile, so it is unknown for a process that
+// ran at the same time as another watched process.
+int64_t processCpuTime(QProcess& process);
+
+// Measures the cpu time (user + system, in msecs) of the watched processes of a
+// group that end between start() and elapsed(), even if they run at the same time.
+// On Unix, this is the cpu time of all the children that ended meanwhile, so it
+// is unknown (-1) if a watched process of another group ended too.
+class ChildrenCpuTimer
+{
+public:
+  explicit ChildrenCpuTimer(const void* group = nullptr);
+
+  void start();
+  int64_t elapsed() const;
+
+private:
+  const void* m_group;
+  int64_t m_startCpuTime = 0;
+  quint64 m_startEndedProcesses = 0;
+  quint64 m_startGroupEndedProcesses = 0;
+  quint64 m_startGroupUnknownProcesses = 0;
+};
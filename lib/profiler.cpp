@@ -0,0 +1,228 @@
+#include "profiler.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QThread>
+#include <QVariant>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Profile
+{
+  std::mutex mutex;
+  QString filePath;
+  std::chrono::steady_clock::time_point start;
+  std::vector<QJsonObject> events;
+};
+
+Profile profile;
+std::atomic<bool> profiling{false};
+std::atomic<uint64_t> next_track{1};
+
+QJsonObject make_event(const char* phase, const char* category, const QString& name, int64_t time)
+{
+  QJsonObject event;
+  event["ph"] = phase;
+  event["cat"] = category;
+  event["name"] = name;
+  event["ts"] = qint64(time);
+  event["pid"] = qint64(QCoreApplication::applicationPid());
+  return event;
+}
+
+QString current_thread_name()
+{
+  QThread* thread = QThread::currentThread();
+  if (qApp && thread == qApp->thread())
+  {
+    return "main";
+  }
+
+  return thread->objectName().isEmpty() ? QString(thread->metaObject()->className()) : thread->objectName();
+}
+
+// Returns a small number for the current thread, and names the thread
+// in the trace the first time it is used.
+int current_thread_id()
+{
+  static std::atomic<int> next_id{1};
+  thread_local const int id = next_id++;
+  thread_local bool named = false;
+
+  if (!named)
+  {
+    named = true;
+
+    QJsonObject event = make_event("M", "", "thread_name", 0);
+    event["tid"] = id;
+    event["args"] = QJsonObject{{"name", current_thread_name() + " " + QString::number(id)}};
+
+    std::lock_guard lock{profile.mutex};
+    profile.events.push_back(event);
+  }
+
+  return id;
+}
+
+} // namespace
+
+void startProfiling(const QString& filePath)
+{
+  std::lock_guard lock{profile.mutex};
+  profile.filePath = filePath;
+  profile.start = std::chrono::steady_clock::now();
+  profile.events.clear();
+  profiling = true;
+}
+
+bool stopProfiling()
+{
+  std::lock_guard lock{profile.mutex};
+
+  if (!profiling)
+  {
+    return true;
+  }
+
+  profiling = false;
+
+  QJsonArray events;
+  for (const QJsonObject& e : profile.events)
+  {
+    events.append(e);
+  }
+  profile.events.clear();
+
+  QJsonObject root;
+  root["traceEvents"] = events;
+  root["displayTimeUnit"] = "ms";
+
+  QFile file{profile.filePath};
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    return false;
+  }
+
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  return true;
+}
+
+bool isProfiling()
+{
+  return profiling.load(std::memory_order_relaxed);
+}
+
+int64_t profilingClock()
+{
+  const auto elapsed = std::chrono::steady_clock::now() - profile.start;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+uint64_t newProfileTrack()
+{
+  return next_track++;
+}
+
+void profileSpan(const char* category, const QString& name, int64_t startTime, uint64_t track, const QString& detail)
+{
+  if (!isProfiling())
+  {
+    return;
+  }
+
+  const int64_t now = profilingClock();
+  const int tid = current_thread_id();
+
+  auto add_detail = [&detail](QJsonObject& event) {
+    if (!detail.isEmpty())
+    {
+      event["args"] = QJsonObject{{"detail", detail}};
+    }
+  };
+
+  std::lock_guard lock{profile.mutex};
+
+  if (track == 0)
+  {
+    QJsonObject event = make_event("X", category, name, startTime);
+    event["dur"] = qint64(now - startTime);
+    event["tid"] = tid;
+    add_detail(event);
+    profile.events.push_back(event);
+  }
+  else
+  {
+    // async events, which are not bound to a thread
+    const QString id = QString::number(track);
+
+    QJsonObject begin = make_event("b", category, name, startTime);
+    begin["id"] = id;
+    begin["tid"] = tid;
+    add_detail(begin);
+    profile.events.push_back(begin);
+
+    QJsonObject end = make_event("e", category, name, now);
+    end["id"] = id;
+    end["tid"] = tid;
+    profile.events.push_back(end);
+  }
+}
+
+void profileProcess(QProcess& process)
+{
+  if (!isProfiling())
+  {
+    return;
+  }
+
+  // a process from a pool may have to wait before being started
+  auto set_start_time = [&process]() { process.setProperty("profileStartTime", qint64(profilingClock())); };
+  if (process.state() == QProcess::NotRunning)
+  {
+    QObject::connect(&process, &QProcess::started, &process, set_start_time);
+  }
+  else
+  {
+    set_start_time();
+  }
+
+  QObject::connect(&process, &QProcess::finished, &process, [&process]() {
+    const QVariant start = process.property("profileStartTime");
+    if (start.isValid())
+    {
+      profileSpan("process",
+                  process.program(),
+                  start.toLongLong(),
+                  newProfileTrack(),
+                  (QStringList() << process.program() << process.arguments()).join(" "));
+    }
+  });
+}
+
+ProfileScope::ProfileScope(const char* category, const QString& name, const QString& detail)
+    : m_category(category)
+{
+  if (isProfiling())
+  {
+    m_name = name;
+    m_detail = detail;
+    m_start = profilingClock();
+  }
+}
+
+ProfileScope::~ProfileScope()
+{
+  if (m_start >= 0)
+  {
+    profileSpan(m_category, m_name, m_start, 0, m_detail);
+  }
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+
+class QProcess;
+
+// Records where the time goes when creating or exporting a project, and writes it
+// as a Chrome trace event file (open it with https://ui.perfetto.dev or chrome://tracing).
+// Recording does nothing until startProfiling() is called.
+
+// The events are kept in memory and written to `filePath` by stopProfiling().
+void startProfiling(const QString& filePath);
+// Returns false if the file cannot be written.
+bool stopProfiling();
+bool isProfiling();
+
+// Time in microseconds since the start of the profiling.
+int64_t profilingClock();
+
+// Returns a new track for profileSpan(); spans of a track are drawn
+// on their own line, and may overlap the spans of other tracks.
+uint64_t newProfileTrack();
+
+// Records a span from `startTime` (see profilingClock()) to now, in the given track,
+// or in the current thread if `track` is 0, in which case the spans must nest.
+void profileSpan(const char* category,
+                 const QString& name,
+                 int64_t startTime,
+                 uint64_t track = 0,
+                 const QString& detail = QString());
+
+// Records the lifetime of a child process, from the time it starts until it finishes.
+// Must be called before the process ends.
+void profileProcess(QProcess& process);
+
+// Records the time between its construction and its destruction, in the current thread.
+class ProfileScope
+{
+public:
+  ProfileScope(const char* category, const QString& name, const QString& detail = QString());
+  ProfileScope(const ProfileScope&) = delete;
+  ~ProfileScope();
+
+private:
+  const char* m_category;
+  QString m_name;
+  QString m_detail;
+  int64_t m_start = -1;
+};
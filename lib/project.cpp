@@ -6,6 +6,7 @@
 #include <QTextStream>
 
 #include <algorithm>
+#include <iterator>
 #include <set>
 
 MatchObject::MatchObject(const QString& text, QObject* parent)
@@ -122,6 +123,48 @@ std::vector<VideoMatch> convert2vm(const std::vector<MatchObject*>& matches, boo
   return result;
 }
 
+// Parses a segment written by TimeSegment::toString(), which does not check its input.
+static bool parse_segment(const QString& text, TimeSegment& segment)
+{
+  const QStringList parts = text.split('-', Qt::SkipEmptyParts);
+  Duration start{0};
+  Duration end{0};
+  if (parts.size() != 2 || !start.parse(parts.front()) || !end.parse(parts.back())
+      || end.toMSecs() < start.toMSecs())
+  {
+    return false;
+  }
+
+  segment = TimeSegment::between(start.toMSecs(), end.toMSecs());
+  return true;
+}
+
+// Parses a line of the candidate list, see the TXT format in project.h.
+static bool parse_candidate(const QString& text, MatchCandidate& candidate)
+{
+  const QStringList fields = text.split(' ', Qt::SkipEmptyParts);
+  if (fields.size() != 3)
+  {
+    return false;
+  }
+
+  const QStringList parts = fields.front().split('~', Qt::SkipEmptyParts);
+  if (parts.size() != 2)
+  {
+    return false;
+  }
+
+  if (!parse_segment(parts.front(), candidate.match.a) || !parse_segment(parts.back(), candidate.match.b))
+  {
+    return false;
+  }
+
+  bool ok[2] = {false, false};
+  candidate.score = fields.at(1).toDouble(&ok[0]);
+  candidate.minDistance = fields.at(2).toInt(&ok[1]);
+  return ok[0] && ok[1];
+}
+
 DubbingProject::DubbingProject(QObject* parent)
     : QObject(parent)
 {}
@@ -271,6 +314,7 @@ bool DubbingProject::load(const QString& projectFilePath)
   m_outputFilePath.clear();
   m_subtitlesFilePath.clear();
   m_matches.clear();
+  m_candidates.clear();
 
   while (!file.atEnd())
   {
@@ -335,6 +379,28 @@ bool DubbingProject::load(const QString& projectFilePath)
         }
       }
     }
+    else if (line.startsWith("BEGIN CANDIDATES"))
+    {
+      while (!file.atEnd())
+      {
+        line = file.readLine().trimmed();
+        if (line.startsWith("END CANDIDATES"))
+        {
+          break;
+        }
+
+        // the candidates are only hints, a bad one does not prevent loading the project
+        MatchCandidate candidate;
+        if (parse_candidate(QString::fromUtf8(line), candidate))
+        {
+          m_candidates.push_back(candidate);
+        }
+        else
+        {
+          qDebug() << "failed to parse candidate: " << line;
+        }
+      }
+    }
     else if (!line.trimmed().isEmpty())
     {
       qDebug() << "ignoring non-emtpy line: " << line.trimmed();
@@ -412,6 +478,18 @@ void DubbingProject::dump(QTextStream& stream)
     stream << "END MATCHLIST"
            << "\n";
   }
+  if (!m_candidates.empty())
+  {
+    stream << "BEGIN CANDIDATES (" << m_candidates.size() << ")"
+           << "\n";
+    for (const MatchCandidate& c : m_candidates)
+    {
+      stream << c.match.a.toString() << "~" << c.match.b.toString() << " " << c.score << " "
+             << c.minDistance << "\n";
+    }
+    stream << "END CANDIDATES"
+           << "\n";
+  }
 }
 
 const QString& DubbingProject::videoFilePath() const
@@ -613,6 +691,41 @@ std::vector<MatchObject*> DubbingProject::matchObjects() const
   return std::vector<MatchObject*>(list.begin(), list.end());
 }
 
+const std::vector<MatchCandidate>& DubbingProject::candidates() const
+{
+  return m_candidates;
+}
+
+void DubbingProject::setCandidates(std::vector<MatchCandidate> candidates)
+{
+  m_candidates = std::move(candidates);
+}
+
+static bool overlap(const TimeSegment& a, const TimeSegment& b)
+{
+  return a.start() < b.end() && b.start() < a.end();
+}
+
+// Returns the candidates whose segment of the first video contains `pos`,
+// in the order of the detector (best first for each scene).
+// The candidates were found before the matches were edited, so those that
+// overlap a match in either video are skipped; they are kept in the project
+// since they become usable again if that match is removed.
+std::vector<MatchCandidate> DubbingProject::candidatesContaining(int64_t pos) const
+{
+  std::vector<MatchCandidate> result;
+  std::copy_if(m_candidates.begin(),
+               m_candidates.end(),
+               std::back_inserter(result),
+               [this, pos](const MatchCandidate& c) {
+                 return c.match.a.contains(pos)
+                        && std::none_of(m_matches.begin(), m_matches.end(), [&c](const MatchObject* m) {
+                             return overlap(c.match.a, m->value().a) || overlap(c.match.b, m->value().b);
+                           });
+               });
+  return result;
+}
+
 void DubbingProject::onMatchChanged()
 {
   auto* const m = qobject_cast<MatchObject*>(sender());
@@ -24,6 +24,9 @@
 // aaa-bbb ~ aaa-bbb
 // aaa-bbb ~ aaa-bbb
 // END MATCHLIST
+// BEGIN CANDIDATES
+// aaa-bbb~aaa-bbb score min-distance
+// END CANDIDATES
 
 class QDir;
 
@@ -115,6 +118,11 @@ public:
   void addMatches(const std::vector<VideoMatch>& values);
   std::vector<MatchObject*> matchObjects() const;
 
+  // The candidate matches kept by the match detector, see MatchDetector::candidates().
+  const std::vector<MatchCandidate>& candidates() const;
+  void setCandidates(std::vector<MatchCandidate> candidates);
+  std::vector<MatchCandidate> candidatesContaining(int64_t pos) const;
+
 Q_SIGNALS:
   void projectFilePathChanged();
   void projectTitleChanged();
@@ -138,6 +146,7 @@ private:
   QString m_subtitlesFilePath;
   QString m_outputFilePath;
   std::vector<MatchObject*> m_matches;
+  std::vector<MatchCandidate> m_candidates;
 };
 
 #endif // PROJECT_H
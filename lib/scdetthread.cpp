@@ -4,6 +4,7 @@
 #include "cache.h"
 #include "exerun.h"
 #include "mediaobject.h"
+#include "profiler.h"
 #include "vfparser.h"
 
 #include <QFile>
@@ -72,12 +73,17 @@ void save_scdet_results_to_disk(const std::vector<SceneChange>& scenechanges,
 ScdetThread::ScdetThread(const MediaObject& media)
     : m_filePath(media.filePath())
     , m_fileName(media.fileName())
-    , m_nbFrames(media.numberOfPackets())
+    , m_cacheKey(media.cacheKey())
 {
 }
 
 ScdetThread::~ScdetThread() {}
 
+QString ScdetThread::cacheFilePath(const QString& cacheKey)
+{
+  return GetCacheFilePath(cacheKey, "scdet");
+}
+
 std::vector<SceneChange>& ScdetThread::scenechanges()
 {
   assert(isFinished());
@@ -86,10 +92,11 @@ std::vector<SceneChange>& ScdetThread::scenechanges()
 
 void ScdetThread::run()
 {
+  ProfileScope profile_scope{"media", "ScdetThread::run", m_fileName};
+
   m_scenechanges.clear();
 
-  const QString cache_filepath = GetCacheDir() + "/" + m_fileName + "."
-                                 + QString::number(m_nbFrames) + ".scdet";
+  const QString cache_filepath = cacheFilePath(m_cacheKey);
 
   if (QFile::exists(cache_filepath))
   {
@@ -10,6 +10,10 @@
 
 class MediaObject;
 
+// Reads the cache file written by the thread.
+bool read_scdet_results_from_disk(std::vector<SceneChange>& scenechanges,
+                                  const QString& cacheFilePath);
+
 class ScdetThread : public QThread
 {
   Q_OBJECT
@@ -19,12 +23,15 @@ public:
 
   std::vector<SceneChange>& scenechanges();
 
+  // path of the cache file of the media with the given cache key
+  static QString cacheFilePath(const QString& cacheKey);
+
 protected:
   void run() final;
 
 private:
   QString m_filePath;
   QString m_fileName;
-  int m_nbFrames;
+  QString m_cacheKey;
   std::vector<SceneChange> m_scenechanges;
 };
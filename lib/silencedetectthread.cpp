@@ -4,6 +4,7 @@
 #include "cache.h"
 #include "exerun.h"
 #include "mediaobject.h"
+#include "profiler.h"
 #include "vfparser.h"
 
 #include <QFileInfo>
@@ -81,18 +82,25 @@ void save_silencedetect_to_disk(const std::vector<TimeSegment>& silences,
 SilencedetectThread::SilencedetectThread(const MediaObject& media)
     : m_filePath(media.filePath())
     , m_fileName(media.fileName())
-    , m_nbFrames(media.numberOfPackets())
+    , m_cacheKey(media.cacheKey())
 {
   CreateCacheDir();
 }
 
 SilencedetectThread::~SilencedetectThread() {}
 
-double SilencedetectThread::duration() const
+double SilencedetectThread::duration()
 {
   return 0.4;
 }
 
+QString SilencedetectThread::cacheFilePath(const QString& cacheKey)
+{
+  return GetCacheFilePath(cacheKey,
+                          "silencedetect",
+                          QString("silencedetect=n=-35dB:d=%1").arg(QString::number(duration())));
+}
+
 std::vector<TimeSegment>& SilencedetectThread::silences()
 {
   assert(isFinished());
@@ -101,12 +109,13 @@ std::vector<TimeSegment>& SilencedetectThread::silences()
 
 void SilencedetectThread::run()
 {
+  ProfileScope profile_scope{"media", "SilencedetectThread::run", m_fileName};
+
   constexpr const char* duration_threshold = "0.4";
 
   m_silences.clear();
 
-  const QString cache_filepath = GetCacheDir() + "/" + m_fileName + "."
-                                 + QString::number(m_nbFrames) + ".silencedetect";
+  const QString cache_filepath = cacheFilePath(m_cacheKey);
 
   if (QFileInfo::exists(cache_filepath))
   {
@@ -0,0 +1,228 @@
+#include "timestretch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace {
+
+constexpr size_t DecimationFactor = 8;
+
+// correlation of `n` samples taken every `step` samples.
+int64_t correlate(const int16_t* a, const int16_t* b, size_t n, size_t step = 1)
+{
+  int64_t result = 0;
+  for (size_t i(0); i < n; i += step)
+  {
+    result += int32_t(a[i]) * int32_t(b[i]);
+  }
+  return result;
+}
+
+template<typename Fun>
+size_t find_max_correlation(size_t first, size_t last, size_t step, size_t fallback, Fun&& corr)
+{
+  size_t best = fallback;
+  int64_t best_corr = std::numeric_limits<int64_t>::min();
+
+  for (size_t candidate = first; candidate <= last; candidate += step)
+  {
+    const int64_t c = corr(candidate);
+    if (c > best_corr)
+    {
+      best_corr = c;
+      best = candidate;
+    }
+  }
+
+  return best;
+}
+
+int16_t to_sample(float value)
+{
+  return std::clamp<float>(std::round(value),
+                           std::numeric_limits<int16_t>::min(),
+                           std::numeric_limits<int16_t>::max());
+}
+
+} // namespace
+
+TimeStretcher::TimeStretcher(std::vector<int16_t> input, int sampleRate, double tempo)
+    : m_input(std::move(input))
+    , m_sampleRate(sampleRate)
+    , m_tempo(tempo)
+{
+  // 40ms frames with 50% overlap, and a search window of +/-2.5ms
+  m_frameSize = std::max(2 * (size_t(sampleRate) / 50), size_t(2));
+  m_tolerance = sampleRate / 400;
+
+  m_output.resize(std::round(m_input.size() / tempo));
+
+  if (m_input.size() < m_frameSize || m_output.size() < m_frameSize)
+  {
+    // too short to be stretched, we just pick the nearest samples
+    for (size_t i(0); i < m_output.size(); ++i)
+    {
+      m_output[i] = m_input[std::min(size_t(std::round(i * tempo)), m_input.size() - 1)];
+    }
+
+    m_available = m_output.size();
+    return;
+  }
+
+  // periodic hann window; two such windows shifted by half their length sum to 1
+  m_window.resize(m_frameSize);
+  for (size_t i(0); i < m_frameSize; ++i)
+  {
+    m_window[i] = 0.5f - 0.5f * std::cos(2 * std::numbers::pi * i / double(m_frameSize));
+  }
+
+  m_decimatedInput.resize(m_input.size() / DecimationFactor + 1, 0);
+  for (size_t i(0); i < m_decimatedInput.size(); ++i)
+  {
+    int32_t acc = 0;
+    for (size_t j(i * DecimationFactor); j < std::min((i + 1) * DecimationFactor, m_input.size()); ++j)
+    {
+      acc += m_input[j];
+    }
+    m_decimatedInput[i] = acc / int32_t(DecimationFactor);
+  }
+
+  m_accumulator.resize(m_output.size() + m_frameSize, 0.f);
+}
+
+int TimeStretcher::sampleRate() const
+{
+  return m_sampleRate;
+}
+
+double TimeStretcher::tempo() const
+{
+  return m_tempo;
+}
+
+size_t TimeStretcher::outputSize() const
+{
+  return m_output.size();
+}
+
+size_t TimeStretcher::numberOfSamplesAvailable() const
+{
+  return m_available;
+}
+
+const int16_t* TimeStretcher::output() const
+{
+  return m_output.data();
+}
+
+void TimeStretcher::produce(size_t count)
+{
+  count = std::min(count, outputSize());
+
+  while (m_available < count)
+  {
+    processNextFrame();
+  }
+}
+
+void TimeStretcher::produceAll()
+{
+  produce(outputSize());
+}
+
+size_t TimeStretcher::memoryUsage() const
+{
+  return m_input.capacity() * sizeof(int16_t) + m_decimatedInput.capacity() * sizeof(int16_t)
+         + m_window.capacity() * sizeof(float) + m_accumulator.capacity() * sizeof(float)
+         + m_output.capacity() * sizeof(int16_t);
+}
+
+void TimeStretcher::processNextFrame()
+{
+  const size_t hop = m_frameSize / 2;
+  const size_t n = m_input.size();
+  const size_t last_start = n - m_frameSize;
+  const size_t k = m_nextFrame++;
+  const size_t nominal = std::min<size_t>(std::round(k * hop * m_tempo), last_start);
+
+  size_t start = nominal;
+
+  // we search the frame (around the nominal position) that best continues
+  // the previous frame; first on the decimated signal, then on the full signal.
+  const size_t natural = m_previousFrameStart + hop;
+  if (k > 0 && natural <= last_start)
+  {
+    const size_t coarse = find_max_correlation(
+        nominal > m_tolerance ? nominal - m_tolerance : 0,
+        std::min(nominal + m_tolerance, last_start),
+        DecimationFactor,
+        nominal,
+        [&](size_t candidate) {
+          return correlate(m_decimatedInput.data() + natural / DecimationFactor,
+                           m_decimatedInput.data() + candidate / DecimationFactor,
+                           m_frameSize / DecimationFactor);
+        });
+
+    start = find_max_correlation(coarse > DecimationFactor ? coarse - DecimationFactor : 0,
+                                 std::min(coarse + DecimationFactor, last_start),
+                                 1,
+                                 coarse,
+                                 [&](size_t candidate) {
+                                   return correlate(m_input.data() + natural,
+                                                    m_input.data() + candidate,
+                                                    m_frameSize,
+                                                    4);
+                                 });
+  }
+
+  float* out = m_accumulator.data() + k * hop;
+  for (size_t i(0); i < m_frameSize; ++i)
+  {
+    // the first half of the first frame is not overlapped by another frame
+    const float w = (k == 0 && i < hop) ? 1.f : m_window[i];
+    out[i] += w * m_input[start + i];
+  }
+
+  m_previousFrameStart = start;
+
+  // samples before the start of the next frame are final
+  const size_t available = std::min((k + 1) * hop, outputSize());
+  for (size_t i(m_available); i < available; ++i)
+  {
+    m_output[i] = to_sample(m_accumulator[i]);
+  }
+
+  m_available = available;
+}
+
+std::vector<int16_t> timeStretch(std::vector<int16_t> samples, int sampleRate, double tempo)
+{
+  TimeStretcher stretcher{std::move(samples), sampleRate, tempo};
+  stretcher.produceAll();
+  return std::vector<int16_t>(stretcher.output(), stretcher.output() + stretcher.outputSize());
+}
+
+std::vector<int16_t> resample(const std::vector<int16_t>& samples, int inputRate, int outputRate)
+{
+  if (inputRate == outputRate || samples.empty())
+  {
+    return samples;
+  }
+
+  const size_t output_size = (samples.size() * int64_t(outputRate)) / inputRate;
+  const double step = inputRate / double(outputRate);
+
+  std::vector<int16_t> result(output_size);
+  for (size_t i(0); i < output_size; ++i)
+  {
+    const double pos = i * step;
+    const size_t j = std::min(size_t(pos), samples.size() - 1);
+    const size_t j1 = std::min(j + 1, samples.size() - 1);
+    const double t = pos - j;
+    result[i] = std::round(samples[j] * (1 - t) + samples[j1] * t);
+  }
+
+  return result;
+}
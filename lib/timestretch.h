@@ -0,0 +1,57 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Changes the tempo of a mono signal without changing its pitch, like the
+// "atempo" filter of ffmpeg: the output lasts `input.size() / tempo` samples.
+// Uses WSOLA (waveform similarity overlap-add), which is good enough for
+// the small ratios (0.9-1.1) we get between two releases of an episode.
+// The output is produced incrementally so that playback can start before
+// the whole signal is processed.
+class TimeStretcher
+{
+public:
+  TimeStretcher(std::vector<int16_t> input, int sampleRate, double tempo);
+
+  int sampleRate() const;
+  double tempo() const;
+
+  size_t outputSize() const;
+  size_t numberOfSamplesAvailable() const;
+  const int16_t* output() const;
+
+  void produce(size_t count);
+  void produceAll();
+
+  // Bytes used by the buffers, which are all allocated by the constructor
+  // and kept until the stretcher is destroyed.
+  size_t memoryUsage() const;
+
+private:
+  void processNextFrame();
+
+private:
+  std::vector<int16_t> m_input;
+  std::vector<int16_t> m_decimatedInput;
+  int m_sampleRate;
+  double m_tempo;
+  size_t m_frameSize;
+  size_t m_tolerance;
+  std::vector<float> m_window;
+  std::vector<float> m_accumulator;
+  std::vector<int16_t> m_output;
+  size_t m_nextFrame = 0;
+  size_t m_previousFrameStart = 0;
+  size_t m_available = 0;
+};
+
+std::vector<int16_t> timeStretch(std::vector<int16_t> samples, int sampleRate, double tempo);
+
+// Linear resampling of a mono signal.
+std::vector<int16_t> resample(const std::vector<int16_t>& samples, int inputRate, int outputRate);
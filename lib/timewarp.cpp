@@ -0,0 +1,410 @@
+#include "timewarp.h"
+
+#include "hashindex.h"
+#include "matchalgo.h"
+#include "matchtrace.h"
+#include "phash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+
+namespace MatchAlgo {
+
+namespace {
+
+// frames of the first video in which each piece is searched
+constexpr size_t ransac_window = 512;
+constexpr int ransac_iterations = 64;
+// the first anchor of a sample is taken among the anchors of the first frames
+// of the window, so that the piece found starts there
+constexpr size_t ransac_start_frames = 4;
+// frames between the two anchors of a sample, below which the speed is too imprecise
+constexpr size_t min_sample_distance = 32;
+constexpr double min_speed = 0.8;
+constexpr double max_speed = 1.25;
+// maximum distance (in frames of the second video) between an anchor and a piece
+// for the anchor to support the piece
+constexpr double inlier_tolerance = 2;
+// frames of the first video that a piece must cover with anchors
+constexpr size_t min_inlier_frames = 4;
+// frames without any supporting anchor after which a piece ends
+constexpr size_t max_inlier_gap = 32;
+
+using Anchor = std::pair<size_t, size_t>;
+
+bool is_inlier(const TimeWarpPiece& piece, const Anchor& anchor)
+{
+  return std::abs(double(anchor.second) - piece.map(anchor.first)) <= inlier_tolerance;
+}
+
+// Least squares fit of j = offset + speed * i.
+class LineFit
+{
+public:
+  void add(const Anchor& anchor)
+  {
+    const double i = double(anchor.first);
+    const double j = double(anchor.second);
+    ++m_count;
+    m_i += i;
+    m_j += j;
+    m_ii += i * i;
+    m_ij += i * j;
+  }
+
+  size_t count() const { return m_count; }
+
+  // Updates the line of `piece`, unless the speed would be out of bounds.
+  void apply(TimeWarpPiece& piece) const
+  {
+    const double n = double(m_count);
+    const double det = n * m_ii - m_i * m_i;
+    if (m_count < 2 || det <= 0)
+    {
+      return;
+    }
+
+    const double speed = (n * m_ij - m_i * m_j) / det;
+    if (speed >= min_speed && speed <= max_speed)
+    {
+      piece.speed = speed;
+      piece.offset = (m_j - speed * m_i) / n;
+    }
+  }
+
+private:
+  size_t m_count = 0;
+  double m_i = 0;
+  double m_j = 0;
+  double m_ii = 0;
+  double m_ij = 0;
+};
+
+// Returns the number of distinct frames of the first video among the anchors
+// of [begin, end) that support `piece`.
+size_t count_inlier_frames(const TimeWarpPiece& piece, const Anchor* begin, const Anchor* end)
+{
+  size_t result = 0;
+  size_t last_frame = std::numeric_limits<size_t>::max();
+  for (const Anchor* it = begin; it != end; ++it)
+  {
+    if (it->first != last_frame && is_inlier(piece, *it))
+    {
+      ++result;
+      last_frame = it->first;
+    }
+  }
+  return result;
+}
+
+// Finds with RANSAC the line supported by the most anchors in [begin, end),
+// among the lines going through one of the anchors of the first frames.
+// The first frame of the piece returned is that of the anchor it goes through.
+std::optional<TimeWarpPiece> find_piece(const Anchor* begin, const Anchor* end, std::mt19937& rng)
+{
+  const Anchor* start_end = begin;
+  for (size_t f(0); f < ransac_start_frames && start_end != end; ++f)
+  {
+    const size_t frame = start_end->first;
+    start_end = std::find_if(start_end, end, [frame](const Anchor& e) {
+      return e.first != frame;
+    });
+  }
+
+  std::optional<TimeWarpPiece> best;
+  size_t best_count = 0;
+
+  std::uniform_int_distribution<size_t> first_dist{0, size_t(start_end - begin) - 1};
+  std::uniform_int_distribution<size_t> second_dist{0, size_t(end - begin) - 1};
+
+  for (int k(0); k < ransac_iterations; ++k)
+  {
+    const Anchor& p = begin[first_dist(rng)];
+    const Anchor& q = begin[second_dist(rng)];
+
+    if (q.first < p.first + min_sample_distance)
+    {
+      continue;
+    }
+
+    TimeWarpPiece piece;
+    piece.first = p.first;
+    piece.speed = (double(q.second) - double(p.second)) / double(q.first - p.first);
+    piece.offset = double(p.second) - piece.speed * double(p.first);
+
+    if (piece.speed < min_speed || piece.speed > max_speed)
+    {
+      continue;
+    }
+
+    const size_t count = count_inlier_frames(piece, begin, end);
+    if (count > best_count)
+    {
+      best_count = count;
+      best = piece;
+    }
+  }
+
+  if (best_count < min_inlier_frames)
+  {
+    return std::nullopt;
+  }
+
+  return best;
+}
+
+// Keeps the pieces forming the chain increasing in the second video
+// with the most anchors.
+std::vector<TimeWarpPiece> increasing_pieces(const std::vector<TimeWarpPiece>& pieces)
+{
+  if (pieces.empty())
+  {
+    return {};
+  }
+
+  constexpr size_t npos = std::numeric_limits<size_t>::max();
+  std::vector<size_t> weight(pieces.size());
+  std::vector<size_t> previous(pieces.size(), npos);
+
+  for (size_t k(0); k < pieces.size(); ++k)
+  {
+    weight[k] = pieces[k].inliers;
+    for (size_t l(0); l < k; ++l)
+    {
+      const bool follows = pieces[k].map(pieces[k].first) > pieces[l].map(pieces[l].last);
+      if (follows && weight[l] + pieces[k].inliers > weight[k])
+      {
+        weight[k] = weight[l] + pieces[k].inliers;
+        previous[k] = l;
+      }
+    }
+  }
+
+  std::vector<TimeWarpPiece> result;
+  for (size_t k = std::max_element(weight.begin(), weight.end()) - weight.begin(); k != npos; k = previous[k])
+  {
+    result.push_back(pieces[k]);
+  }
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+// Keeps, for each frame of `a`, the anchors with the closest frames of `b`.
+// The frames of a scene are similar to each other, so that the anchors of a frame
+// are spread over the whole scene, and any line going through the scene would be
+// supported by some of them.
+std::vector<Anchor> closest_anchors(const FrameSpan& a, const FrameSpan& b, const std::vector<Anchor>& anchors)
+{
+  std::vector<Anchor> result;
+  std::vector<int> distances;
+
+  for (auto it = anchors.begin(); it != anchors.end();)
+  {
+    const size_t i = it->first;
+    auto frame_end = std::find_if(it, anchors.end(), [i](const Anchor& e) {
+      return e.first != i;
+    });
+
+    distances.clear();
+    for (auto cur = it; cur != frame_end; ++cur)
+    {
+      distances.push_back(phashDist(a.hash(i), b.hash(cur->second)));
+    }
+
+    const int best = *std::min_element(distances.begin(), distances.end());
+    for (size_t k(0); k < distances.size(); ++k)
+    {
+      if (distances[k] == best)
+      {
+        result.push_back(it[k]);
+      }
+    }
+
+    it = frame_end;
+  }
+
+  return result;
+}
+
+} // namespace
+
+TimeWarpModel TimeWarpModel::fit(const std::vector<std::pair<size_t, size_t>>& anchors)
+{
+  TimeWarpModel model;
+  std::vector<TimeWarpPiece> pieces;
+
+  // fixed seed, so that results are reproducible
+  std::mt19937 rng{42};
+
+  const Anchor* const anchors_end = anchors.data() + anchors.size();
+  const Anchor* it = anchors.data();
+
+  while (it != anchors_end)
+  {
+    const Anchor* window_end = std::lower_bound(it, anchors_end, it->first + ransac_window, [](const Anchor& e, size_t i) {
+      return e.first < i;
+    });
+
+    std::optional<TimeWarpPiece> piece = find_piece(it, window_end, rng);
+
+    if (!piece)
+    {
+      // the anchors of this frame do not start a piece
+      const size_t frame = it->first;
+      it = std::find_if(it, anchors_end, [frame](const Anchor& e) {
+        return e.first != frame;
+      });
+      continue;
+    }
+
+    // grows the piece, refining the line as more anchors support it
+    LineFit fit;
+    const Anchor* last_inlier = nullptr;
+    size_t inlier_frames = 0;
+    for (const Anchor* cur = it; cur != anchors_end; ++cur)
+    {
+      if (is_inlier(*piece, *cur))
+      {
+        if (!last_inlier)
+        {
+          piece->first = std::min(piece->first, cur->first);
+        }
+        if (!last_inlier || last_inlier->first != cur->first)
+        {
+          ++inlier_frames;
+        }
+        last_inlier = cur;
+        fit.add(*cur);
+        if (fit.count() % 16 == 0)
+        {
+          fit.apply(*piece);
+        }
+      }
+      else if (cur->first > (last_inlier ? last_inlier->first : piece->first) + max_inlier_gap)
+      {
+        break;
+      }
+    }
+
+    fit.apply(*piece);
+    piece->last = last_inlier->first;
+    piece->inliers = inlier_frames;
+    pieces.push_back(*piece);
+
+    const size_t frame = last_inlier->first;
+    it = std::find_if(last_inlier, anchors_end, [frame](const Anchor& e) {
+      return e.first != frame;
+    });
+  }
+
+  model.m_pieces = increasing_pieces(pieces);
+  return model;
+}
+
+const TimeWarpPiece* TimeWarpModel::pieceAt(size_t i) const
+{
+  auto it = std::upper_bound(m_pieces.begin(), m_pieces.end(), i, [](size_t i, const TimeWarpPiece& p) {
+    return i < p.first;
+  });
+
+  if (it == m_pieces.begin() || std::prev(it)->last < i)
+  {
+    return nullptr;
+  }
+
+  return &*std::prev(it);
+}
+
+std::vector<std::pair<FrameSpan, FrameSpan>> match_time_warp(const FrameSpan& a,
+                                                             const FrameSpan& b,
+                                                             const HashIndex& index,
+                                                             const Parameters& params)
+{
+  constexpr size_t anchor_step = 4;
+  constexpr size_t max_hits = 64;
+  constexpr size_t min_match_length = 4;
+
+  std::vector<std::pair<FrameSpan, FrameSpan>> result;
+
+  const TimeWarpModel model = TimeWarpModel::fit(
+      closest_anchors(a, b, find_similar_frames(index, a, b, params.seedRadius, anchor_step, max_hits)));
+
+  MATCH_TRACE(Summary, "time-warp model").field("a", a).field("b", b).field("pieces", model.pieces().size());
+  for (const TimeWarpPiece& piece : model.pieces())
+  {
+    MATCH_TRACE(Segments, "time-warp piece")
+        .field("first", piece.first)
+        .field("last", piece.last)
+        .field("offset", piece.offset)
+        .field("speed", piece.speed)
+        .field("inliers", piece.inliers);
+  }
+
+  auto map = [&b](const TimeWarpPiece& piece, size_t i) -> std::optional<size_t> {
+    const double j = std::round(piece.map(i));
+    if (j < 0 || j >= double(b.size()))
+    {
+      return std::nullopt;
+    }
+    return size_t(j);
+  };
+
+  auto frames_match = [&](size_t i, size_t j) {
+    return phashDist(a.hash(i), b.hash(j)) < params.frameUnmatchThreshold;
+  };
+
+  const std::vector<TimeWarpPiece>& pieces = model.pieces();
+
+  // the first frames of each video that the next piece may use
+  size_t next_a = 0;
+  size_t next_b = 0;
+
+  for (size_t k(0); k < pieces.size(); ++k)
+  {
+    const TimeWarpPiece& piece = pieces[k];
+    const bool has_next = k + 1 < pieces.size();
+    const size_t end_a = has_next ? pieces[k + 1].first : a.size();
+    const double end_b = has_next ? pieces[k + 1].map(pieces[k + 1].first) : double(b.size());
+
+    size_t first = piece.first;
+    while (first > next_a)
+    {
+      const std::optional<size_t> j = map(piece, first - 1);
+      if (!j || *j < next_b || !frames_match(first - 1, *j))
+      {
+        break;
+      }
+      --first;
+    }
+
+    size_t last = piece.last;
+    while (last + 1 < end_a)
+    {
+      const std::optional<size_t> j = map(piece, last + 1);
+      if (!j || double(*j) >= end_b || !frames_match(last + 1, *j))
+      {
+        break;
+      }
+      ++last;
+    }
+
+    const std::optional<size_t> first_b = map(piece, first);
+    const std::optional<size_t> last_b = map(piece, last);
+
+    if (!first_b || !last_b || *first_b < next_b || last + 1 - first < min_match_length)
+    {
+      continue;
+    }
+
+    result.emplace_back(a.subspan(first, last + 1 - first), b.subspan(*first_b, *last_b + 1 - *first_b));
+    next_a = last + 1;
+    next_b = *last_b + 1;
+  }
+
+  return result;
+}
+
+} // namespace MatchAlgo
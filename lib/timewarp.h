@@ -0,0 +1,69 @@
+// Copyright (C) 2026 Vincent Chambrin
+// This file is part of the 'digidub' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef TIMEWARP_H
+#define TIMEWARP_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace MatchAlgo {
+
+class FrameSpan;
+class HashIndex;
+struct Parameters;
+
+// A linear piece of a time-warp model: frame i of the first video, for i in
+// [first, last], corresponds to frame offset + speed * i of the second video.
+struct TimeWarpPiece
+{
+  size_t first = 0;
+  size_t last = 0;
+  double offset = 0;
+  double speed = 1;
+  size_t inliers = 0; // number of anchors supporting the piece
+
+  double map(size_t i) const { return offset + speed * double(i); }
+};
+
+// A piecewise-linear mapping from the frames of a video to the frames of another video.
+// The breakpoints between the pieces are where content was inserted or removed,
+// or where the speed changes.
+class TimeWarpModel
+{
+public:
+  // Fits a model to pairs of frames (i, j) that are likely to correspond,
+  // sorted by i. Some of them may be wrong (e.g. similar frames of different scenes).
+  // Each piece is found with RANSAC among the anchors that follow the previous piece,
+  // then grown while the anchors agree with it.
+  // The pieces are increasing in both videos.
+  static TimeWarpModel fit(const std::vector<std::pair<size_t, size_t>>& anchors);
+
+  const std::vector<TimeWarpPiece>& pieces() const;
+
+  // Returns the piece containing frame i of the first video, or nullptr.
+  const TimeWarpPiece* pieceAt(size_t i) const;
+
+private:
+  std::vector<TimeWarpPiece> m_pieces;
+};
+
+inline const std::vector<TimeWarpPiece>& TimeWarpModel::pieces() const
+{
+  return m_pieces;
+}
+
+// Fits a TimeWarpModel to the frames of `a` and `b` with nearly identical hashes
+// (within Parameters::seedRadius, found with `index`, which must be built over the
+// video of `b`), then returns the matching areas given by its pieces.
+// The ends of each piece are moved to the first and last frames that actually match.
+std::vector<std::pair<FrameSpan, FrameSpan>> match_time_warp(const FrameSpan& a,
+                                                             const FrameSpan& b,
+                                                             const HashIndex& index,
+                                                             const Parameters& params);
+
+} // namespace MatchAlgo
+
+#endif // TIMEWARP_H
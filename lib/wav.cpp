@@ -179,6 +179,15 @@ int readWavSampleRate(const QString& filePath)
     return {};
   }
 
+  return readWavInfo(file).sampleRate;
+}
+
+WavInfo readWavInfo(QFile& file)
+{
+  WavInfo result;
+
+  file.seek(0);
+
   // Read the WAV header
   WavHeader header;
   file.read(reinterpret_cast<char*>(&header), sizeof(WavHeader));
@@ -200,7 +209,16 @@ int readWavSampleRate(const QString& filePath)
       FmtChunk chunk;
       file.read(reinterpret_cast<char*>(&chunk) + sizeof(ChunkHeader),
                 sizeof(FmtChunk) - sizeof(ChunkHeader));
-      return chunk.sample_rate;
+      file.seek(file.pos() + chkheader.chunk_size - (sizeof(FmtChunk) - sizeof(ChunkHeader)));
+      result.sampleRate = chunk.sample_rate;
+      result.numChannels = chunk.num_channels;
+      result.bitsPerSample = chunk.bits_per_sample;
+    }
+    else if (std::string(chkheader.chunk_ID, 4) == "data")
+    {
+      result.dataOffset = file.pos();
+      result.dataSize = chkheader.chunk_size;
+      break;
     }
     else
     {
@@ -208,5 +226,33 @@ int readWavSampleRate(const QString& filePath)
     }
   }
 
-  return 0;
+  return result;
+}
+
+// Reads `count` samples starting at sample `first` from a 16-bit wav file.
+// Samples outside of the data chunk are read as silence.
+std::vector<int16_t> readWavSamples(QFile& file, const WavInfo& info, int64_t first, int64_t count)
+{
+  std::vector<int16_t> result(std::max<int64_t>(count, 0), 0);
+
+  if (info.bitsPerSample != 16 || info.numChannels != 1)
+  {
+    qDebug() << "Only 1-channel 16-bit wav are supported";
+    return result;
+  }
+
+  const int64_t nb_samples = info.dataSize / int64_t(sizeof(int16_t));
+  const int64_t begin = std::clamp<int64_t>(first, 0, nb_samples);
+  const int64_t end = std::clamp<int64_t>(first + count, 0, nb_samples);
+
+  if (begin >= end)
+  {
+    return result;
+  }
+
+  file.seek(info.dataOffset + begin * int64_t(sizeof(int16_t)));
+  file.read(reinterpret_cast<char*>(result.data() + (begin - first)),
+            (end - begin) * int64_t(sizeof(int16_t)));
+
+  return result;
 }
@@ -6,6 +6,8 @@
 
 #include <QString>
 
+class QFile;
+
 #include <algorithm>
 #include <cstdint>
 #include <vector>
@@ -31,3 +33,15 @@ inline WavSample makeWavSample(int high, int low)
 
 std::vector<WavSample> readWav(const QString& filePath);
 int readWavSampleRate(const QString& filePath);
+
+struct WavInfo
+{
+  int sampleRate = 0;
+  int numChannels = 0;
+  int bitsPerSample = 0;
+  int64_t dataOffset = 0; // position of the first sample in the file
+  int64_t dataSize = 0;   // in bytes
+};
+
+WavInfo readWavInfo(QFile& file);
+std::vector<int16_t> readWavSamples(QFile& file, const WavInfo& info, int64_t first, int64_t count);